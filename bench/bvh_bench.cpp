@@ -0,0 +1,175 @@
+#include <args.hxx>
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <glm/glm.hpp>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "config.hpp"
+#include "independent-sampler.hpp"
+#include "parser.hpp"
+#include "samplers.hpp"
+#include "scene.hpp"
+#include "topology.hpp"
+
+/**
+ * Compares the traversal speed of the binary, 4-wide and 8-wide BVH on the
+ * camera rays, one diffuse bounce and one shadow ray per pixel of a scene,
+ * and the camera rays traced one at a time against packets of neighbouring
+ * pixels.
+ */
+int main(int argc, char* argv[]) {
+  args::ArgumentParser args("bvh_bench");
+  args::HelpFlag help_arg(args, "help", "display this help menu",
+                          {'h', "help"});
+  args::Positional<std::string> scene_arg(args, "scene", "the scene file");
+  args::Positional<std::string> mat_arg(args, "materials",
+                                        "the materials directory");
+  args::Positional<std::string> config_arg(args, "config", "the config file");
+  args::ValueFlag<int> rounds_arg(args, "rounds", "timed rounds per width",
+                                  {'r', "rounds"}, 5);
+
+  try {
+    args.ParseCLI(argc, argv);
+  } catch (args::Help) {
+    std::cout << args;
+    return 0;
+  } catch (args::Error e) {
+    std::cerr << e.what() << std::endl;
+    return 1;
+  }
+
+  std::ifstream config_file(args::get(config_arg));
+  if (!config_file) {
+    std::cerr << "Please specify an existing config file." << std::endl;
+    return 1;
+  }
+
+  Config config;
+  try {
+    nlohmann::json config_json;
+    config_file >> config_json;
+    config = config_json;
+  } catch (nlohmann::detail::exception e) {
+    std::cerr << e.what() << std::endl;
+    return 1;
+  }
+
+  spdlog::set_level(spdlog::level::warn);
+  if (config.job.threads == 0) {
+    config.job.threads = Topology::detect().cpus();
+  }
+
+  auto load = [&](int width) {
+    Config copy = config;
+    copy.bvh.width = width;
+    Parser parser(copy);
+    Scene scene = parser.parse(args::get(scene_arg), args::get(mat_arg));
+    scene.camera.set_position(config.camera.position, config.camera.center,
+                              config.camera.up);
+    scene.camera.set_view(glm::radians(config.camera.fovy),
+                          config.camera.width, config.camera.height);
+    return scene;
+  };
+
+  // Generate the same rays for every width using the binary tree.
+  std::vector<Ray> rays;
+  std::vector<Ray> cameras;
+  std::vector<Ray> shadows;
+  std::vector<float> distances;
+  {
+    Scene scene = load(2);
+    IndependentSampler sampler(1);
+
+    for (int y = 0; y < scene.camera.height; y++) {
+      for (int x = 0; x < scene.camera.width; x++) {
+        sampler.start(y * scene.camera.width + x, 0);
+        Ray ray = scene.camera.pixel_ray(x, y, sampler);
+        rays.push_back(ray);
+        cameras.push_back(ray);
+
+        auto inter = scene.bvh.intersect(ray);
+        if (!inter) {
+          continue;
+        }
+
+        glm::vec3 N = glm::dot(inter.N, ray.D) < 0 ? inter.N : -inter.N;
+        glm::vec3 O = ray.at(inter.t) + config.rendering.epsilon * N;
+        rays.emplace_back(O, samplers::cos_weighted_hemi(N, sampler));
+
+        if (!scene.lights.empty()) {
+          auto& light = scene.lights[sampler.bounded(scene.lights.size())];
+          glm::vec3 P = light->sample(O, sampler).P;
+          shadows.emplace_back(O, P - O);
+          distances.push_back(glm::distance(O, P) - config.rendering.epsilon);
+        }
+      }
+    }
+  }
+
+  using Clock = std::chrono::steady_clock;
+  int rounds = args::get(rounds_arg);
+  double baseline = 0;
+
+  std::cout << "width  closest (Mrays/s)  shadow (Mrays/s)  speedup  "
+            << "camera (Mrays/s)  packet (Mrays/s)" << std::endl;
+
+  for (int width : {2, 4, 8}) {
+    Scene scene = load(width);
+
+    // Accumulate hits so the traversal cannot be optimized away.
+    size_t hits = 0;
+    double closest = 0;
+    double shadow = 0;
+    double single = 0;
+    double packet = 0;
+    BVH::Intersection inters[BVH::PACKET_SIZE];
+
+    for (int r = 0; r < rounds; r++) {
+      auto start = Clock::now();
+      for (const auto& ray : rays) {
+        hits += static_cast<bool>(scene.bvh.intersect(ray));
+      }
+      closest += std::chrono::duration<double>(Clock::now() - start).count();
+
+      start = Clock::now();
+      for (size_t i = 0; i < shadows.size(); i++) {
+        hits += scene.bvh.occluded(shadows[i], distances[i]);
+      }
+      shadow += std::chrono::duration<double>(Clock::now() - start).count();
+
+      start = Clock::now();
+      for (const auto& ray : cameras) {
+        hits += static_cast<bool>(scene.bvh.intersect(ray));
+      }
+      single += std::chrono::duration<double>(Clock::now() - start).count();
+
+      start = Clock::now();
+      for (size_t i = 0; i < cameras.size(); i += BVH::PACKET_SIZE) {
+        int count = std::min<size_t>(BVH::PACKET_SIZE, cameras.size() - i);
+        scene.bvh.intersect_packet(&cameras[i], count, inters);
+        for (int j = 0; j < count; j++) {
+          hits += static_cast<bool>(inters[j]);
+        }
+      }
+      packet += std::chrono::duration<double>(Clock::now() - start).count();
+    }
+
+    double closest_rate = rays.size() * rounds / closest * 1e-6;
+    double shadow_rate = shadows.size() * rounds / shadow * 1e-6;
+    double total = closest + shadow;
+    double single_rate = cameras.size() * rounds / single * 1e-6;
+    double packet_rate = cameras.size() * rounds / packet * 1e-6;
+
+    if (width == 2) {
+      baseline = total;
+    }
+
+    std::printf("%5d  %17.2f  %16.2f  %6.2fx  %16.2f  %16.2f  (%zu hits)\n",
+                width, closest_rate, shadow_rate, baseline / total,
+                single_rate, packet_rate, hits);
+  }
+
+  return 0;
+}
@@ -0,0 +1,156 @@
+#include <args.hxx>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <glm/glm.hpp>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "config.hpp"
+#include "film.hpp"
+#include "parser.hpp"
+#include "scene.hpp"
+#include "topology.hpp"
+#include "worker.hpp"
+
+/**
+ * Compares the rendering speed of the image split into full width strips
+ * against square tiles handed out in scanline, Morton and Hilbert order, and
+ * of the path integrator against the wavefront integrator on Hilbert tiles.
+ */
+int main(int argc, char* argv[]) {
+  args::ArgumentParser args("render_bench");
+  args::HelpFlag help_arg(args, "help", "display this help menu",
+                          {'h', "help"});
+  args::Positional<std::string> scene_arg(args, "scene", "the scene file");
+  args::Positional<std::string> mat_arg(args, "materials",
+                                        "the materials directory");
+  args::Positional<std::string> config_arg(args, "config", "the config file");
+  args::ValueFlag<int> rounds_arg(args, "rounds", "timed rounds per layout",
+                                  {'r', "rounds"}, 3);
+  args::ValueFlag<int> samples_arg(args, "samples", "samples per pixel",
+                                   {'s', "samples"}, 4);
+
+  try {
+    args.ParseCLI(argc, argv);
+  } catch (args::Help) {
+    std::cout << args;
+    return 0;
+  } catch (args::Error e) {
+    std::cerr << e.what() << std::endl;
+    return 1;
+  }
+
+  std::ifstream config_file(args::get(config_arg));
+  if (!config_file) {
+    std::cerr << "Please specify an existing config file." << std::endl;
+    return 1;
+  }
+
+  Config config;
+  try {
+    nlohmann::json config_json;
+    config_file >> config_json;
+    config = config_json;
+  } catch (nlohmann::detail::exception e) {
+    std::cerr << e.what() << std::endl;
+    return 1;
+  }
+
+  spdlog::set_level(spdlog::level::warn);
+  if (config.job.threads == 0) {
+    config.job.threads = Topology::detect().cpus();
+  }
+  config.rendering.samples = args::get(samples_arg);
+  config.adaptive.threshold = 0;
+
+  Parser parser(config);
+  Scene scene = parser.parse(args::get(scene_arg), args::get(mat_arg));
+  scene.camera.set_position(config.camera.position, config.camera.center,
+                            config.camera.up);
+  scene.camera.set_view(glm::radians(config.camera.fovy), config.camera.width,
+                        config.camera.height);
+
+  int width = scene.camera.width;
+  int height = scene.camera.height;
+  int size = config.job.tile;
+
+  // Strips span the image width and hold about as many pixels as a tile.
+  std::vector<Worker::Work> strips;
+  int rows = std::max(1, size * size / width);
+  for (int y = 0; y < height; y += rows) {
+    strips.push_back(Worker::Work{glm::ivec2(0, y),
+                                  glm::ivec2(width, std::min(y + rows, height)),
+                                  0});
+  }
+
+  auto render = [&](const std::vector<Worker::Work>& work,
+                    const Config& config) {
+    Film film(width, height);
+    Worker::Queue queue(work, config.job.threads, Worker::batch(config));
+    std::atomic<int> running(config.job.threads);
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < config.job.threads; i++) {
+      threads.emplace_back(Worker(config, scene, film, queue, i, running));
+    }
+
+    std::for_each(threads.begin(), threads.end(), mem_fn(&std::thread::join));
+  };
+
+  using Clock = std::chrono::steady_clock;
+  int rounds = args::get(rounds_arg);
+  double rays = static_cast<double>(width * height) * config.rendering.samples;
+  double baseline = 0;
+
+  // Returns the seconds taken by all rounds of rendering the work.
+  auto time = [&](const std::vector<Worker::Work>& work, const Config& config) {
+    double elapsed = 0;
+    for (int r = 0; r < rounds; r++) {
+      auto start = Clock::now();
+      render(work, config);
+      elapsed += std::chrono::duration<double>(Clock::now() - start).count();
+    }
+    return elapsed;
+  };
+
+  std::cout << "layout    tiles  camera (Mrays/s)  speedup" << std::endl;
+
+  for (std::string order : {"strips", "scanline", "morton", "hilbert"}) {
+    auto work = order == "strips" ? strips
+                                  : Worker::tiles(width, height, size, order);
+
+    double elapsed = time(work, config);
+    double rate = rays * rounds / elapsed * 1e-6;
+
+    if (order == "strips") {
+      baseline = elapsed;
+    }
+
+    std::printf("%-8s  %5zu  %16.3f  %6.2fx\n", order.c_str(), work.size(),
+                rate, baseline / elapsed);
+  }
+
+  std::cout << std::endl
+            << "integrator  camera (Mrays/s)  speedup" << std::endl;
+
+  auto tiles = Worker::tiles(width, height, size, "hilbert");
+  for (std::string integrator : {"path", "wavefront"}) {
+    Config copy = config;
+    copy.rendering.integrator = integrator;
+
+    double elapsed = time(tiles, copy);
+    double rate = rays * rounds / elapsed * 1e-6;
+
+    if (integrator == "path") {
+      baseline = elapsed;
+    }
+
+    std::printf("%-10s  %16.3f  %6.2fx\n", integrator.c_str(), rate,
+                baseline / elapsed);
+  }
+
+  return 0;
+}
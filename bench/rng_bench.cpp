@@ -0,0 +1,68 @@
+#include <args.hxx>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <random>
+#include "rng.hpp"
+
+/**
+ * Compares the speed of drawing uniform floats and light indices from
+ * std::mt19937 with the standard distributions against the PCG32 generator
+ * used by the render threads.
+ */
+int main(int argc, char* argv[]) {
+  args::ArgumentParser args("rng_bench");
+  args::HelpFlag help_arg(args, "help", "display this help menu",
+                          {'h', "help"});
+  args::ValueFlag<int> count_arg(args, "count", "millions of numbers drawn",
+                                 {'n', "count"}, 100);
+  args::ValueFlag<int> rounds_arg(args, "rounds", "timed rounds per generator",
+                                  {'r', "rounds"}, 5);
+
+  try {
+    args.ParseCLI(argc, argv);
+  } catch (args::Help) {
+    std::cout << args;
+    return 0;
+  } catch (args::Error e) {
+    std::cerr << e.what() << std::endl;
+    return 1;
+  }
+
+  using Clock = std::chrono::steady_clock;
+  long count = args::get(count_arg) * 1000000L;
+  int rounds = args::get(rounds_arg);
+
+  // Returns the rate in millions per second of calling draw count times. The
+  // results are accumulated so the calls cannot be optimized away.
+  double sink = 0;
+  auto time = [&](auto draw) {
+    double elapsed = 0;
+    for (int r = 0; r < rounds; r++) {
+      auto start = Clock::now();
+      for (long i = 0; i < count; i++) {
+        sink += draw();
+      }
+      elapsed += std::chrono::duration<double>(Clock::now() - start).count();
+    }
+    return count * rounds / elapsed * 1e-6;
+  };
+
+  std::mt19937 mt(1);
+  std::uniform_real_distribution<float> real(0, 1);
+  std::uniform_int_distribution<int> integer(0, 7);
+  RNG pcg(1);
+
+  double mt_float = time([&]() { return real(mt); });
+  double pcg_float = time([&]() { return pcg.uniform(); });
+  double mt_int = time([&]() { return integer(mt); });
+  double pcg_int = time([&]() { return pcg.bounded(8); });
+
+  std::cout << "generator  float (M/s)  index (M/s)" << std::endl;
+  std::printf("mt19937    %11.1f  %11.1f\n", mt_float, mt_int);
+  std::printf("pcg32      %11.1f  %11.1f\n", pcg_float, pcg_int);
+  std::printf("speedup    %10.2fx  %10.2fx  (%g)\n", pcg_float / mt_float,
+              pcg_int / mt_int, sink);
+
+  return 0;
+}
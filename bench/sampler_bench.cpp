@@ -0,0 +1,174 @@
+#include <args.hxx>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <glm/glm.hpp>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "config.hpp"
+#include "film.hpp"
+#include "image.hpp"
+#include "parser.hpp"
+#include "scene.hpp"
+#include "topology.hpp"
+#include "worker.hpp"
+
+/**
+ * Compares the convergence of the samplers at equal time. Every sampler
+ * renders the scene at increasing sample counts and the error is measured
+ * against a reference rendered with many independent samples. The efficiency
+ * 1 / (error * time) compares samplers at equal render time since the mean
+ * squared error of Monte Carlo estimates falls inversely with time.
+ *
+ * Direct lighting with and without multiple importance sampling is compared
+ * the same way with the Sobol sampler.
+ */
+int main(int argc, char* argv[]) {
+  args::ArgumentParser args("sampler_bench");
+  args::HelpFlag help_arg(args, "help", "display this help menu",
+                          {'h', "help"});
+  args::Positional<std::string> scene_arg(args, "scene", "the scene file");
+  args::Positional<std::string> mat_arg(args, "materials",
+                                        "the materials directory");
+  args::Positional<std::string> config_arg(args, "config", "the config file");
+  args::ValueFlag<int> size_arg(args, "size", "width and height of the render",
+                                {'s', "size"}, 64);
+  args::ValueFlag<int> samples_arg(args, "samples", "maximum samples per pixel",
+                                   {'n', "samples"}, 64);
+  args::ValueFlag<int> reference_arg(args, "reference",
+                                     "samples per pixel of the reference",
+                                     {'r', "reference"}, 1024);
+
+  try {
+    args.ParseCLI(argc, argv);
+  } catch (args::Help) {
+    std::cout << args;
+    return 0;
+  } catch (args::Error e) {
+    std::cerr << e.what() << std::endl;
+    return 1;
+  }
+
+  std::ifstream config_file(args::get(config_arg));
+  if (!config_file) {
+    std::cerr << "Please specify an existing config file." << std::endl;
+    return 1;
+  }
+
+  Config config;
+  try {
+    nlohmann::json config_json;
+    config_file >> config_json;
+    config = config_json;
+  } catch (nlohmann::detail::exception e) {
+    std::cerr << e.what() << std::endl;
+    return 1;
+  }
+
+  spdlog::set_level(spdlog::level::warn);
+  if (config.job.threads == 0) {
+    config.job.threads = Topology::detect().cpus();
+  }
+
+  int size = args::get(size_arg);
+  Parser parser(config);
+  Scene scene = parser.parse(args::get(scene_arg), args::get(mat_arg));
+  scene.camera.set_position(config.camera.position, config.camera.center,
+                            config.camera.up);
+  scene.camera.set_view(glm::radians(config.camera.fovy), size, size);
+
+  // Renders the scene and returns the time it took in seconds.
+  auto render = [&](const std::string& sampler, bool mis, int samples,
+                    Image& image) {
+    Config copy = config;
+    copy.rendering.sampler = sampler;
+    copy.rendering.mis = mis;
+    copy.rendering.samples = samples;
+    copy.job.batch = samples;
+    copy.adaptive.threshold = 0;
+
+    auto start = std::chrono::steady_clock::now();
+
+    Film film(size, size);
+    Worker::Queue queue(
+        Worker::tiles(size, size, copy.job.tile, copy.job.order),
+        copy.job.threads, Worker::batch(copy));
+    std::atomic<int> running(copy.job.threads);
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < copy.job.threads; i++) {
+      threads.emplace_back(Worker(copy, scene, film, queue, i, running));
+    }
+    std::for_each(threads.begin(), threads.end(), mem_fn(&std::thread::join));
+
+    image = film.resolve();
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                         start)
+        .count();
+  };
+
+  // Use another seed for the reference so its noise is not shared.
+  Image reference(size, size);
+  config.rendering.seed += 1;
+  render("independent", true, args::get(reference_arg), reference);
+  config.rendering.seed -= 1;
+
+  auto error = [&](const Image& image) {
+    double sum = 0;
+    for (size_t i = 0; i < image.size(); i++) {
+      Color a = image.get_pixel(i);
+      Color b = reference.get_pixel(i);
+      sum += (a.r - b.r) * (a.r - b.r) + (a.g - b.g) * (a.g - b.g) +
+             (a.b - b.b) * (a.b - b.b);
+    }
+    return sum / (3 * image.size());
+  };
+
+  std::cout << "sampler      samples  time (s)  rmse      efficiency"
+            << std::endl;
+
+  for (int samples = 1; samples <= args::get(samples_arg); samples *= 4) {
+    double baseline = 0;
+
+    for (std::string sampler : {"independent", "halton", "sobol"}) {
+      Image image(size, size);
+      double time = render(sampler, config.rendering.mis, samples, image);
+      double mse = error(image);
+      double efficiency = 1 / (mse * time);
+
+      if (sampler == "independent") {
+        baseline = efficiency;
+      }
+
+      std::printf("%-11s  %7d  %8.3f  %.6f  %6.2fx\n", sampler.c_str(),
+                  samples, time, std::sqrt(mse), efficiency / baseline);
+    }
+  }
+
+  std::cout << std::endl
+            << "mis    samples  time (s)  rmse      efficiency" << std::endl;
+
+  for (int samples = 1; samples <= args::get(samples_arg); samples *= 4) {
+    double baseline = 0;
+
+    for (bool mis : {false, true}) {
+      Image image(size, size);
+      double time = render("sobol", mis, samples, image);
+      double mse = error(image);
+      double efficiency = 1 / (mse * time);
+
+      if (!mis) {
+        baseline = efficiency;
+      }
+
+      std::printf("%-5s  %7d  %8.3f  %.6f  %6.2fx\n", mis ? "on" : "off",
+                  samples, time, std::sqrt(mse), efficiency / baseline);
+    }
+  }
+
+  return 0;
+}
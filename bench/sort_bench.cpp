@@ -0,0 +1,239 @@
+#include <args.hxx>
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <glm/glm.hpp>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "config.hpp"
+#include "film.hpp"
+#include "parser.hpp"
+#include "scene.hpp"
+#include "topology.hpp"
+#include "worker.hpp"
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#define SORT_BENCH_PERF
+#endif
+
+/**
+ * Hardware event counter of the process and the threads it starts while the
+ * counter is open. Reads -1 where perf events are not available, such as
+ * outside of Linux or with a restrictive perf_event_paranoid setting.
+ */
+class Counter {
+ public:
+  /**
+   * Last level cache misses or L1 data cache read misses.
+   */
+  enum Event { LLC_MISSES, L1D_MISSES };
+
+  explicit Counter(Event event) : fd(-1), error("not supported") {
+#ifdef SORT_BENCH_PERF
+    perf_event_attr attr;
+    std::memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    if (event == LLC_MISSES) {
+      attr.type = PERF_TYPE_HARDWARE;
+      attr.config = PERF_COUNT_HW_CACHE_MISSES;
+    } else {
+      attr.type = PERF_TYPE_HW_CACHE;
+      attr.config = PERF_COUNT_HW_CACHE_L1D |
+                    (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                    (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+    }
+    attr.disabled = 1;
+    attr.inherit = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    fd = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+    if (fd < 0) {
+      error = std::strerror(errno);
+    }
+#endif
+  }
+
+  ~Counter() {
+#ifdef SORT_BENCH_PERF
+    if (fd >= 0) {
+      close(fd);
+    }
+#endif
+  }
+
+  void start() {
+#ifdef SORT_BENCH_PERF
+    if (fd >= 0) {
+      ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+      ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+#endif
+  }
+
+  /**
+   * Returns why the counter could not be opened or nullptr if it is open.
+   */
+  const char* failure() const {
+    return fd < 0 ? error : nullptr;
+  }
+
+  int64_t stop() {
+    int64_t count = -1;
+#ifdef SORT_BENCH_PERF
+    if (fd >= 0) {
+      ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+      if (read(fd, &count, sizeof(count)) != sizeof(count)) {
+        count = -1;
+      }
+    }
+#endif
+    return count;
+  }
+
+ private:
+  int fd;
+
+  const char* error;
+};
+
+/**
+ * Measures the speed and cache misses of the wavefront integrator with and
+ * without sorting secondary rays by direction and origin and hits by material,
+ * against the path integrator. The counters include the worker threads.
+ */
+int main(int argc, char* argv[]) {
+  args::ArgumentParser args("sort_bench");
+  args::HelpFlag help_arg(args, "help", "display this help menu",
+                          {'h', "help"});
+  args::Positional<std::string> scene_arg(args, "scene", "the scene file");
+  args::Positional<std::string> mat_arg(args, "materials",
+                                        "the materials directory");
+  args::Positional<std::string> config_arg(args, "config", "the config file");
+  args::ValueFlag<int> rounds_arg(args, "rounds", "timed rounds per mode",
+                                  {'r', "rounds"}, 3);
+  args::ValueFlag<int> samples_arg(args, "samples", "samples per pixel",
+                                   {'s', "samples"}, 4);
+
+  try {
+    args.ParseCLI(argc, argv);
+  } catch (args::Help) {
+    std::cout << args;
+    return 0;
+  } catch (args::Error e) {
+    std::cerr << e.what() << std::endl;
+    return 1;
+  }
+
+  std::ifstream config_file(args::get(config_arg));
+  if (!config_file) {
+    std::cerr << "Please specify an existing config file." << std::endl;
+    return 1;
+  }
+
+  Config config;
+  try {
+    nlohmann::json config_json;
+    config_file >> config_json;
+    config = config_json;
+  } catch (nlohmann::detail::exception e) {
+    std::cerr << e.what() << std::endl;
+    return 1;
+  }
+
+  spdlog::set_level(spdlog::level::warn);
+  if (config.job.threads == 0) {
+    config.job.threads = Topology::detect().cpus();
+  }
+  config.rendering.samples = args::get(samples_arg);
+  config.adaptive.threshold = 0;
+
+  Parser parser(config);
+  Scene scene = parser.parse(args::get(scene_arg), args::get(mat_arg));
+  scene.camera.set_position(config.camera.position, config.camera.center,
+                            config.camera.up);
+  scene.camera.set_view(glm::radians(config.camera.fovy), config.camera.width,
+                        config.camera.height);
+
+  int width = scene.camera.width;
+  int height = scene.camera.height;
+  auto tiles = Worker::tiles(width, height, config.job.tile, config.job.order);
+
+  auto render = [&](const Config& config) {
+    Film film(width, height);
+    Worker::Queue queue(tiles, config.job.threads, Worker::batch(config));
+    std::atomic<int> running(config.job.threads);
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < config.job.threads; i++) {
+      threads.emplace_back(Worker(config, scene, film, queue, i, running));
+    }
+
+    std::for_each(threads.begin(), threads.end(), mem_fn(&std::thread::join));
+  };
+
+  Counter llc_misses(Counter::LLC_MISSES);
+  Counter l1d_misses(Counter::L1D_MISSES);
+
+  // Virtual machines often hide the hardware counters from the guest.
+  for (const Counter* counter : {&llc_misses, &l1d_misses}) {
+    if (counter->failure()) {
+      std::cerr << "Cache misses are not counted: " << counter->failure()
+                << std::endl;
+      break;
+    }
+  }
+
+  using Clock = std::chrono::steady_clock;
+  int rounds = args::get(rounds_arg);
+  double rays = static_cast<double>(width * height) *
+                config.rendering.samples * rounds;
+  double baseline = 0;
+
+  std::cout << "mode             camera (Mrays/s)  speedup  LLC miss/ray  "
+            << "L1D miss/ray" << std::endl;
+
+  for (std::string mode : {"path", "wavefront", "wavefront sorted"}) {
+    Config copy = config;
+    copy.rendering.integrator = mode == "path" ? "path" : "wavefront";
+    copy.rendering.sort = mode == "wavefront sorted";
+
+    llc_misses.start();
+    l1d_misses.start();
+    auto start = Clock::now();
+    for (int r = 0; r < rounds; r++) {
+      render(copy);
+    }
+    double elapsed =
+        std::chrono::duration<double>(Clock::now() - start).count();
+    int64_t llc = llc_misses.stop();
+    int64_t l1 = l1d_misses.stop();
+
+    if (mode == "path") {
+      baseline = elapsed;
+    }
+
+    std::printf("%-16s  %16.3f  %6.2fx", mode.c_str(), rays / elapsed * 1e-6,
+                baseline / elapsed);
+    for (int64_t count : {llc, l1}) {
+      if (count < 0) {
+        std::printf("  %12s", "n/a");
+      } else {
+        std::printf("  %12.2f", count / rays);
+      }
+    }
+    std::printf("\n");
+  }
+
+  return 0;
+}
@@ -1,24 +1,42 @@
+#include <cstdint>
 #include <memory>
 #include "light.hpp"
-#include "triangle.hpp"
+#include "mesh.hpp"
 
 #ifndef AREA_LIGHT_HPP_
 #define AREA_LIGHT_HPP_
 
 class AreaLight : public Light {
  private:
-  std::shared_ptr<Triangle> T;
+  std::shared_ptr<const Mesh> mesh;
+
+  uint32_t id;
 
  public:
-  explicit AreaLight(std::shared_ptr<Triangle> T);
+  /**
+   * Creates a light emitting from the triangle of the mesh.
+   */
+  AreaLight(std::shared_ptr<const Mesh> mesh, uint32_t id);
 
   /**
-   * Returns a uniformly sampled point on the underlying triangle with the color
-   * intensity divided by the PDF as described in these slides...
+   * Returns a uniformly sampled point on the underlying triangle. Its density
+   * over the area of the triangle is converted to solid angle as described in
+   * these slides...
    *
    * https://inst.eecs.berkeley.edu/~cs283/sp13/lectures/283-lecture10.pdf
    */
-  Sample sample(const glm::vec3& P, Light::RNG& rng) const override;
+  Sample sample(const glm::vec3& P, Sampler& sampler) const override;
+
+  /**
+   * Returns the density with respect to solid angle at P of uniformly
+   * sampling point X on triangle id of the mesh. Both sides of the triangle
+   * emit light.
+   */
+  static float pdf(const Mesh& mesh, uint32_t id, const glm::vec3& P,
+                   const glm::vec3& X);
+
+  std::unique_ptr<Light> replicate(
+      std::shared_ptr<const Mesh> mesh) const override;
 };
 
 #endif  // AREA_LIGHT_HPP_
@@ -1,10 +1,28 @@
 #include <glm/glm.hpp>
+#include <limits>
 #include "ray.hpp"
 
 #ifndef BOUNDING_BOX_HPP_
 #define BOUNDING_BOX_HPP_
 
 struct BoundingBox {
+  struct Intersection {
+    /**
+     * The distance at which the ray enters the bounding box.
+     */
+    float tmin;
+
+    /**
+     * The distance at which the ray exits the bounding box.
+     */
+    float tmax;
+
+    /**
+     * Checks if the intersection exists.
+     */
+    operator bool() const;
+  };
+
   glm::vec3 min;
 
   glm::vec3 max;
@@ -35,9 +53,18 @@ struct BoundingBox {
   glm::vec3 center() const;
 
   /**
-   * Checks if the ray intersects with the bounding box.
+   * Returns the surface area of the bounding box.
+   */
+  float surface_area() const;
+
+  /**
+   * Calculates the entry and exit distances of the ray clipped to the
+   * [0, tmax] interval. The intersection does not exist if the ray misses the
+   * bounding box within the interval.
    */
-  bool intersects(const Ray& ray) const;
+  Intersection intersects(
+      const Ray& ray,
+      float tmax = std::numeric_limits<float>::infinity()) const;
 };
 
 #endif  // BOUNDING_BOX_HPP_
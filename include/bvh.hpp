@@ -1,26 +1,47 @@
 #include <spdlog/spdlog.h>
+#include <cstdint>
 #include <glm/glm.hpp>
 #include <memory>
 #include <vector>
 #include "bounding-box.hpp"
-#include "primitive.hpp"
+#include "cache.hpp"
+#include "config.hpp"
+#include "mesh.hpp"
 #include "ray.hpp"
+#include "triangle.hpp"
 
 #ifndef BVH_HPP_
 #define BVH_HPP_
 
 /**
- * Bounding volume hierarchy of scene primitives.
+ * Bounding volume hierarchy of the triangles of a mesh.
  */
 class BVH {
  public:
-  struct Intersection : public Primitive::Intersection {
+  struct Intersection : public Mesh::Intersection {
     /**
-     * Pointer to the intersecting primitive.
+     * Id of the intersecting triangle.
      */
-    Primitive* primitive = nullptr;
+    uint32_t triangle = 0;
   };
 
+  /**
+   * Largest supported value of the max_depth BVH config.
+   */
+  static constexpr int MAX_DEPTH = 64;
+
+  /**
+   * Largest number of rays traversed together by intersect_packet(...).
+   */
+  static constexpr int PACKET_SIZE = 8;
+
+  /**
+   * Morton codes use 10 bits for each axis.
+   */
+  static constexpr int MORTON_BITS = 30;
+
+  static constexpr float MORTON_GRID = 1 << (MORTON_BITS / 3);
+
   BVH();
 
   /**
@@ -28,79 +49,440 @@ class BVH {
    */
   Intersection intersect(const Ray& ray) const;
 
+  /**
+   * Calculates the intersections of up to PACKET_SIZE rays with the scene.
+   * Rays whose directions lie in the same octant, such as the camera rays of
+   * nearby pixels, traverse the tree together and nodes are culled for the
+   * whole packet at once with interval arithmetic. Other packets fall back to
+   * intersect(...) for each ray. The results are the same either way.
+   */
+  void intersect_packet(const Ray* rays, int count,
+                        Intersection* intersections) const;
+
+  /**
+   * Checks if anything in the scene blocks the ray closer than tmax. This
+   * returns on the first hit found and skips the shading attributes so it is
+   * cheaper than intersect(...) for shadow rays.
+   */
+  bool occluded(const Ray& ray, float tmax) const;
+
   /**
    * Returns bounding box of the entire scene.
    */
   BoundingBox get_bounds() const;
 
   /**
-   * Creates a BVH, transferring ownership of the primitives to the tree.
+   * Returns the mesh the tree was built over. Only valid for a built tree.
+   */
+  const Mesh& get_mesh() const;
+
+  /**
+   * Writes the nodes of the tree to a cache. The mesh is not written so the
+   * caller has to cache it separately.
+   */
+  void write(cache::Writer& writer) const;
+
+  /**
+   * Reads a tree written by write(...) over the same mesh.
+   */
+  static BVH read(cache::Reader& reader, std::shared_ptr<const Mesh> mesh,
+                  const Config& config);
+
+  /**
+   * Creates a BVH over all triangles of the mesh. The tree is built with the
+   * algorithm and limits in the BVH section of the config.
+   */
+  static BVH build(std::shared_ptr<const Mesh> mesh, const Config& config);
+
+  /**
+   * Interleaves the bits of a point in the [0, MORTON_GRID) cube.
+   */
+  static uint32_t morton(const glm::vec3& p);
+
+  /**
+   * Returns a copy of the tree over the given copy of its mesh. The nodes and
+   * records are written by the calling thread so the operating system places
+   * them on its NUMA node.
    */
-  static BVH build(std::vector<Primitive::SharedPtr>&& primitives);
+  BVH replicate(std::shared_ptr<const Mesh> mesh) const;
 
  private:
+  /**
+   * Node of the flattened tree. Nodes are stored in depth-first order so the
+   * first child of an interior node immediately follows its parent.
+   */
   struct Node {
-    using NodePtr = std::unique_ptr<Node>;
+    BoundingBox bounds;
 
     /**
-     * Bounding box needs to be recreated before expanding!
+     * Index of the first primitive for leaves or of the second child for
+     * interior nodes.
      */
-    BoundingBox bounds;
+    uint32_t offset = 0;
+
+    /**
+     * The number of primitives in a leaf. Zero for interior nodes.
+     */
+    uint16_t count = 0;
+
+    uint16_t pad = 0;
+  };
+
+  static_assert(sizeof(Node) == 32, "BVH nodes should be 32 bytes.");
+
+  /**
+   * Node of a W-wide tree collapsed from the binary tree. The child bounds are
+   * stored in structure of arrays form so they can be tested in one SIMD slab
+   * test. Leaf children reference primitives directly.
+   */
+  template <int W>
+  struct WideNode {
+    /**
+     * Child bounds as min x, min y, min z, max x, max y, max z.
+     */
+    float bounds[6][W];
 
-    NodePtr left;
+    /**
+     * Index of the child node or of the first primitive for leaf children.
+     */
+    uint32_t child[W];
+
+    /**
+     * The number of primitives in a leaf child. Zero for interior children.
+     */
+    uint16_t count[W];
+
+    /**
+     * The number of used child slots.
+     */
+    uint32_t size;
+
+    uint8_t pad[(64 - (30 * W + 4) % 64) % 64];
+  };
+
+  static_assert(sizeof(WideNode<4>) == 128, "BVH4 nodes should be 128 bytes.");
+  static_assert(sizeof(WideNode<8>) == 256, "BVH8 nodes should be 256 bytes.");
+
+  /**
+   * Closest hit found by a traversal. Shading attributes are interpolated
+   * only once the traversal is done.
+   */
+  struct Hit : public Triangle::Hit {
+    /**
+     * Leaf order index of the triangle.
+     */
+    uint32_t index;
+  };
+
+  /**
+   * Rays traversed together along with their closest hits and the bounds of
+   * their origins and inverse directions used for interval arithmetic.
+   */
+  struct Packet {
+    const Ray* rays;
+
+    int count;
+
+    Triangle::Shear shears[PACKET_SIZE];
+
+    Hit hits[PACKET_SIZE];
 
-    NodePtr right;
+    /**
+     * Whether the directions of all rays are negative along each axis.
+     */
+    bool negative[3];
+
+    glm::vec3 Omin;
+
+    glm::vec3 Omax;
+
+    glm::vec3 invDmin;
+
+    glm::vec3 invDmax;
 
     /**
-     * The number of primitives under this nodes hierarchy.
+     * Returns the distance of the farthest closest hit. Nodes beyond it
+     * cannot improve any hit of the packet.
      */
-    size_t size = 0;
+    float tmax() const;
 
     /**
-     * Contains all of the primitives that are stored DIRECTLY at this node.
+     * Returns a lower bound of the distance at which any ray of the packet
+     * enters the box, or infinity if all rays miss it within tmax.
      */
-    std::vector<Primitive*> primitives;
+    float enters(const glm::vec3& min, const glm::vec3& max, float tmax) const;
+  };
+
+  /**
+   * Triangle bounds cached for the duration of a build.
+   */
+  struct Reference {
+    BoundingBox bounds;
+
+    glm::vec3 center;
 
-    explicit Node(const BoundingBox& bounds);
+    uint32_t index;
+  };
+
+  /**
+   * Morton code of a primitive centroid.
+   */
+  struct Morton {
+    uint32_t code;
+
+    uint32_t index;
   };
 
   enum Axis { X, Y, Z };
 
+  using Iterator = std::vector<Reference>::iterator;
+
+  /**
+   * Relative SAH cost of traversing an interior node.
+   */
+  static constexpr float TRAVERSAL_COST = 1.0f;
+
+  /**
+   * Relative SAH cost of intersecting a single primitive.
+   */
+  static constexpr float INTERSECTION_COST = 1.0f;
+
+  /**
+   * Largest number of primitives a leaf node can address.
+   */
+  static constexpr size_t MAX_LEAF_SIZE = UINT16_MAX;
+
+  /**
+   * Size of the traversal stack. Covers MAX_DEPTH plus the median splits of
+   * oversized leaves and the extra child pushed at the deepest level.
+   */
+  static constexpr int STACK_SIZE = 2 * MAX_DEPTH;
+
   /**
-   * Max height of the BVH.
+   * Minimum number of references for building a node with multiple threads.
    */
-  static constexpr int MAX_HEIGHT = 20;
+  static constexpr size_t PARALLEL_SIZE = 1 << 14;
 
   /**
-   * Minimum number of primitives to split.
+   * Morton codes are radix sorted in 3 passes of 10 bits.
    */
-  static constexpr int MIN_SIZE = 10;
+  static constexpr int RADIX_BITS = 10;
+
+  static constexpr int RADIX_BUCKETS = 1 << RADIX_BITS;
 
   static std::shared_ptr<spdlog::logger> LOG;
 
-  Node root;
+  /**
+   * The branching factor of the tree used for traversal.
+   */
+  int width = 2;
+
+  BoundingBox bounds;
+
+  std::vector<Node> nodes;
+
+  std::vector<WideNode<4>> nodes4;
+
+  std::vector<WideNode<8>> nodes8;
+
+  std::shared_ptr<const Mesh> mesh;
+
+  /**
+   * Triangle ids ordered so each leaf references a contiguous range.
+   */
+  std::vector<uint32_t> triangles;
+
+  /**
+   * Precomputed intersection records in the same order as the ids.
+   */
+  std::vector<Triangle> records;
+
+  /**
+   * Selects the watertight intersection kernel.
+   */
+  bool watertight = false;
+
+  /**
+   * Creates a BVH from flattened nodes and triangle ids in leaf order.
+   */
+  BVH(std::vector<Node>&& nodes, std::shared_ptr<const Mesh> mesh,
+      std::vector<uint32_t>&& triangles);
+
+  /**
+   * Precomputes the intersection records for the kernel selected by the
+   * config.
+   */
+  void prepare(const Config& config);
+
+  /**
+   * Interpolates the shading attributes of the closest hit of the ray.
+   */
+  Intersection resolve(const Ray& ray, const Hit& hit) const;
+
+  /**
+   * Closest hit traversal of the binary tree. The hit distance has to be
+   * initialized to the maximum distance.
+   */
+  void intersect(const Ray& ray, const Triangle::Shear& shear,
+                 const std::vector<Node>& nodes, Hit& hit) const;
+
+  /**
+   * Any hit traversal of the binary tree.
+   */
+  bool occluded(const Ray& ray, const Triangle::Shear& shear, float tmax,
+                const std::vector<Node>& nodes) const;
+
+  /**
+   * Closest hit traversal of a wide tree. The hit distance has to be
+   * initialized to the maximum distance.
+   */
+  template <int W>
+  void intersect(const Ray& ray, const Triangle::Shear& shear,
+                 const std::vector<WideNode<W>>& wide, Hit& hit) const;
+
+  /**
+   * Any hit traversal of a wide tree.
+   */
+  template <int W>
+  bool occluded(const Ray& ray, const Triangle::Shear& shear, float tmax,
+                const std::vector<WideNode<W>>& wide) const;
+
+  /**
+   * Closest hit traversal of the binary tree for a packet of rays.
+   */
+  void intersect(Packet& packet, const std::vector<Node>& nodes) const;
+
+  /**
+   * Closest hit traversal of a wide tree for a packet of rays.
+   */
+  template <int W>
+  void intersect(Packet& packet, const std::vector<WideNode<W>>& wide) const;
+
+  /**
+   * Tests the records of a leaf against every ray of the packet with the
+   * kernel chosen by the watertight config.
+   */
+  void intersect_leaf(Packet& packet, uint32_t begin, uint32_t end) const;
+
+  /**
+   * Tests the records of a leaf and updates the closest hit.
+   */
+  void intersect_leaf(const Ray& ray, const Triangle::Shear& shear,
+                      uint32_t begin, uint32_t end, Hit& hit) const;
+
+  /**
+   * Checks if any record of a leaf blocks the ray closer than tmax.
+   */
+  bool occluded_leaf(const Ray& ray, const Triangle::Shear& shear,
+                     uint32_t begin, uint32_t end, float tmax) const;
+
+  /**
+   * Replaces the binary nodes with a W-wide tree.
+   */
+  template <int W>
+  void collapse(std::vector<WideNode<W>>& wide);
+
+  /**
+   * Appends a wide node holding up to W descendants of the binary node by
+   * repeatedly opening the interior descendant with the largest surface area.
+   * Returns the index of the wide node.
+   */
+  template <int W>
+  uint32_t collapse(std::vector<WideNode<W>>& wide, uint32_t index) const;
+
+  /**
+   * Appends a sub-tree with a limited height containing the referenced
+   * primitives to the nodes in depth-first order. Large sub-trees are split
+   * across the given number of threads.
+   */
+  static void build(std::vector<Node>& nodes, Iterator begin, Iterator end,
+                    uint32_t offset, int height, int threads,
+                    const Config::BVH& config);
 
-  std::vector<Primitive::SharedPtr> primitives;
+  /**
+   * Appends both sub-trees of the node by calling build(nodes, right,
+   * threads) for each side. Large sub-trees are built in parallel into
+   * separate arrays and appended in depth-first order, so the result does not
+   * depend on the number of threads.
+   */
+  template <typename F>
+  static void fork(std::vector<Node>& nodes, uint32_t index, size_t size,
+                   int threads, F build);
+
+  /**
+   * Calculates the bounds of the references and of their centroids.
+   */
+  static void measure(Iterator begin, Iterator end, int threads,
+                      BoundingBox& bounds, BoundingBox& centroids);
+
+  /**
+   * Stable partition of the references which is parallel for large ranges.
+   */
+  template <typename P>
+  static Iterator partition(Iterator begin, Iterator end, int threads,
+                            P predicate);
+
+  /**
+   * Calls f(chunk, begin, end) for each of the contiguous chunks of the
+   * [0, size) range in parallel.
+   */
+  template <typename F>
+  static void parallel_chunks(size_t size, int threads, F f);
+
+  /**
+   * Partitions the references around the center of the widest axis of the
+   * bounds. Returns the first reference of the right half.
+   */
+  static Iterator split_midpoint(Iterator begin, Iterator end,
+                                 const BoundingBox& bounds, int threads);
+
+  /**
+   * Partitions the references along the cheapest of the binned SAH planes.
+   * Returns the first reference of the right half or end if no plane
+   * separates the primitive centroids.
+   */
+  static Iterator split_sah(Iterator begin, Iterator end,
+                            const BoundingBox& centroids, int threads,
+                            const Config::BVH& config);
+
+  /**
+   * Builds a linear BVH by sorting the references along a Morton curve of
+   * their centroids and splitting ranges at the highest differing code bit.
+   * This is much faster but produces lower quality trees than the other
+   * builders.
+   */
+  static void build_lbvh(std::vector<Node>& nodes,
+                         std::vector<Reference>& references, int threads,
+                         const Config::BVH& config);
+
+  /**
+   * Appends the sub-tree of a range of references sorted by their Morton
+   * keys. Bits above bit are identical across the range.
+   */
+  static void emit_lbvh(std::vector<Node>& nodes, Iterator begin, Iterator end,
+                        const uint32_t* keys, uint32_t offset, int bit,
+                        int height, int threads, const Config::BVH& config);
 
   /**
-   * Creates a BVH with the given root node.
+   * Stable parallel least significant digit radix sort of the Morton codes.
    */
-  BVH(Node&& root, std::vector<Primitive::SharedPtr>&& primitives);
+  static void radix_sort(std::vector<Morton>& codes, int threads);
 
   /**
-   * Calculates the intersection of this ray with the primitives in the node.
+   * Partially sorts the references by centroid along the axis and returns the
+   * median.
    */
-  Intersection intersect(const Ray& ray, Node const* node) const;
+  static Iterator split_median(Iterator begin, Iterator end, Axis axis);
 
   /**
-   * Creates a sub-tree with a limited height containing the primitives.
+   * Calculates the SAH cost of the tree relative to the area of the root.
    */
-  static Node::NodePtr build(std::vector<Primitive*>& primitives, int height);
+  static float sah_cost(const std::vector<Node>& nodes);
 
   /**
-   * Calculates the widest axis on which to split the node.
+   * Calculates the widest axis of the bounds.
    */
-  static Axis get_split_axis(Node const* node);
+  static Axis get_split_axis(const BoundingBox& bounds);
 
   /**
    * Helper that returns the coordinate of v corresponding to the axis.
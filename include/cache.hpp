@@ -0,0 +1,147 @@
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#ifndef CACHE_HPP_
+#define CACHE_HPP_
+
+/**
+ * Helpers for the binary scene cache. Values are stored in native byte order
+ * and layout so a cache is only valid on the platform that wrote it. Cache
+ * keys include platform(...) so caches of other platforms are not loaded.
+ */
+namespace cache {
+/**
+ * Initial value of hash(...).
+ */
+constexpr uint64_t HASH_SEED = 14695981039346656037ull;
+
+/**
+ * Continues a 64-bit FNV-1a hash of the bytes.
+ */
+uint64_t hash(const void* data, size_t size, uint64_t seed = HASH_SEED);
+
+/**
+ * Continues the hash with the byte order, the sizes and alignments of the
+ * basic types and the compiler, which together determine the layout of
+ * cached values.
+ */
+uint64_t platform(uint64_t seed = HASH_SEED);
+
+/**
+ * Read only view of an entire file. The file is memory mapped on platforms
+ * that support it and read into memory otherwise.
+ */
+class File {
+ public:
+  /**
+   * Opens the file or throws std::runtime_error.
+   */
+  explicit File(const std::string& path);
+
+  File(const File&) = delete;
+
+  File& operator=(const File&) = delete;
+
+  ~File();
+
+  const char* data() const;
+
+  size_t size() const;
+
+ private:
+  const char* begin = nullptr;
+
+  size_t length = 0;
+
+  bool mapped = false;
+
+  std::vector<char> buffer;
+};
+
+/**
+ * Sequentially reads values from a file written by a Writer. Throws
+ * std::runtime_error when reading past the end of the file.
+ */
+class Reader {
+ public:
+  explicit Reader(const File& file);
+
+  template <typename T>
+  T read() {
+    static_assert(std::is_trivially_copyable<T>::value,
+                  "Only trivially copyable values can be cached.");
+    T value;
+    take(&value, sizeof(T));
+    return value;
+  }
+
+  template <typename T>
+  void read(std::vector<T>& values) {
+    static_assert(std::is_trivially_copyable<T>::value,
+                  "Only trivially copyable values can be cached.");
+    values.resize(read<uint64_t>());
+    take(values.data(), values.size() * sizeof(T));
+  }
+
+  std::string read_string();
+
+ private:
+  const char* it;
+
+  const char* end;
+
+  void take(void* out, size_t size);
+};
+
+/**
+ * Writes values to a temporary file which replaces the destination on
+ * commit(). Concurrent renders therefore never observe partial caches.
+ * Throws std::runtime_error on failure.
+ */
+class Writer {
+ public:
+  explicit Writer(const std::string& path);
+
+  ~Writer();
+
+  template <typename T>
+  void write(const T& value) {
+    static_assert(std::is_trivially_copyable<T>::value,
+                  "Only trivially copyable values can be cached.");
+    put(&value, sizeof(T));
+  }
+
+  template <typename T>
+  void write(const std::vector<T>& values) {
+    static_assert(std::is_trivially_copyable<T>::value,
+                  "Only trivially copyable values can be cached.");
+    write<uint64_t>(values.size());
+    put(values.data(), values.size() * sizeof(T));
+  }
+
+  void write_string(const std::string& value);
+
+  /**
+   * Flushes the temporary file and moves it to the destination.
+   */
+  void commit();
+
+ private:
+  std::string path;
+
+  std::string temp;
+
+  std::ofstream out;
+
+  bool committed = false;
+
+  void put(const void* data, size_t size);
+};
+}  // namespace cache
+
+#endif  // CACHE_HPP_
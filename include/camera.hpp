@@ -1,6 +1,6 @@
 #include <glm/glm.hpp>
-#include <random>
 #include "ray.hpp"
+#include "sampler.hpp"
 
 #ifndef CAMERA_HPP_
 #define CAMERA_HPP_
@@ -20,10 +20,6 @@ struct Camera {
 
   int height;  // Image height
 
-  mutable std::mt19937 gen;
-
-  Camera();
-
   /**
    * Sets up the camera to point towards C from the position P oriented with
    * up vector U.
@@ -36,9 +32,9 @@ struct Camera {
   void set_view(float fovy, int width, int height);
 
   /**
-   * Returns a ray through the (x, y) pixel.
+   * Returns a random ray through the (x, y) pixel.
    */
-  Ray pixel_ray(int x, int y) const;
+  Ray pixel_ray(int x, int y, Sampler& sampler) const;
 };
 
 #endif  // CAMERA_HPP_
@@ -1,5 +1,7 @@
 #include <glm/glm.hpp>
+#include <cstdint>
 #include <json.hpp>
+#include <string>
 #include "color.hpp"
 
 #ifndef CONFIG_HPP_
@@ -40,14 +42,51 @@ struct Config {
 
   struct Job {
     /**
-     * The number of threads to use for rendering.
+     * The number of threads to use for rendering, or 0 for one per CPU the
+     * process may run on.
      */
     int threads;
 
     /**
-     * The number of partitions to split the image into for rendering.
+     * How render threads are pinned to CPUs. Either "none" to let the
+     * operating system move them, "compact" to fill the CPUs of one NUMA node
+     * before the next or "scatter" to spread them evenly over the nodes.
      */
-    int partitions;
+    std::string affinity;
+
+    /**
+     * Copies the scene to every NUMA node so pinned threads only read local
+     * memory. Costs one copy of the mesh, BVH and textures per node.
+     */
+    bool replicate;
+
+    /**
+     * The width and height in pixels of the square tiles the image is split
+     * into for rendering.
+     */
+    int tile;
+
+    /**
+     * The order in which tiles are handed out. Either "scanline" for row by
+     * row or "morton" or "hilbert" to follow a space filling curve. The
+     * Hilbert curve keeps consecutive tiles adjacent.
+     */
+    std::string order;
+
+    /**
+     * The number of samples taken of each pixel of a tile before it is
+     * written to the image and requeued. Larger batches cut scheduling and
+     * image updates at the cost of coarser progressive renders. Renders with a
+     * time limit take one sample at a time.
+     */
+    int batch;
+
+    /**
+     * The number of seconds after which rendering stops with every pixel
+     * within one sample of the same number of samples, or 0 to render all
+     * samples.
+     */
+    float time_limit;
   };
 
   struct Rendering {
@@ -72,6 +111,72 @@ struct Config {
      * The uniform scene background color that acts as environment lighting.
      */
     Color background;
+
+    /**
+     * The seed every random number is derived from together with the pixel
+     * and sample index. Renders with the same seed and sample batch are
+     * identical regardless of the number of threads, also with adaptive
+     * sampling, unless they are stopped by the time limit.
+     */
+    uint64_t seed;
+
+    /**
+     * The source of the random numbers of each sample. Either "independent"
+     * for uncorrelated random numbers or "halton" or "sobol" for low
+     * discrepancy points which cover the pixel and the sampled directions
+     * more evenly and reduce noise at equal sample counts. The Owen scrambled
+     * Sobol sampler converges fastest at power of two sample counts.
+     */
+    std::string sampler;
+
+    /**
+     * Either "path" to trace the samples of a tile one path at a time or
+     * "wavefront" to advance all of them together bounce by bounce. Both
+     * render the same image.
+     */
+    std::string integrator;
+
+    /**
+     * Sorts the secondary rays of the wavefront integrator by direction
+     * octant and origin before they are traced, and the hits by material
+     * before they are shaded, so rays which follow each other touch the same
+     * BVH nodes and textures. Does not change the image.
+     */
+    bool sort;
+
+    /**
+     * Combines direct light samples with the reflected rays on diffuse and
+     * glossy surfaces by multiple importance sampling. Otherwise diffuse
+     * surfaces only find direct light by sampling lights and glossy surfaces
+     * only by reflection, which is noisy on rough glossy surfaces.
+     */
+    bool mis;
+  };
+
+  struct Adaptive {
+    /**
+     * Tiles stop sampling once the relative standard error of the mean of
+     * every pixel falls below this threshold. The samples they save go to the
+     * noisy tiles so rendering.samples becomes the average number of samples
+     * per pixel. Zero to sample every pixel equally.
+     */
+    float threshold;
+
+    /**
+     * The number of samples per pixel before the error of a tile is trusted.
+     */
+    int min_samples;
+
+    /**
+     * The most samples per pixel noisy tiles may take.
+     */
+    int max_samples;
+
+    /**
+     * Specifies if the number of samples per pixel should be saved next to
+     * the render as a grayscale heatmap.
+     */
+    bool heatmap;
   };
 
   struct Loader {
@@ -86,6 +191,52 @@ struct Config {
      * inconsistent.
      */
     bool normals;
+
+    /**
+     * Directory in which parsed scenes and their BVH are cached. Later renders
+     * of the same scene with the same loader and BVH settings load the cache
+     * instead of parsing the OBJ and building the BVH. Empty to disable.
+     */
+    std::string cache;
+  };
+
+  struct BVH {
+    /**
+     * The BVH construction algorithm. Either "midpoint" to split nodes at the
+     * center of their widest axis, "sah" to split nodes using a binned
+     * Surface Area Heuristic or "lbvh" to sort primitives along a Morton
+     * curve. The LBVH builder is the fastest which makes it a good fit for
+     * previews and debug renders.
+     */
+    std::string builder;
+
+    /**
+     * The branching factor of the traversed tree. Either 2 for a binary tree
+     * or 4 or 8 to collapse the built tree into nodes whose children are
+     * tested with a single SSE or AVX slab test.
+     */
+    int width;
+
+    /**
+     * Nodes with at most this many primitives are not split any further.
+     */
+    int leaf_size;
+
+    /**
+     * The maximum depth of the BVH.
+     */
+    int max_depth;
+
+    /**
+     * The number of centroid bins per axis evaluated by the SAH builder.
+     */
+    int bins;
+
+    /**
+     * Use the slower watertight triangle intersection instead of
+     * Moller-Trumbore so rays never leak through edges shared by triangles.
+     */
+    bool watertight;
   };
 
   struct Debug {
@@ -106,8 +257,12 @@ struct Config {
 
   Rendering rendering;
 
+  Adaptive adaptive;
+
   Loader loader;
 
+  BVH bvh;
+
   Debug debug;
 };
 
@@ -0,0 +1,61 @@
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+#ifndef DEQUE_HPP_
+#define DEQUE_HPP_
+
+/**
+ * Lock-free work stealing deque of non-negative integers. The owning thread
+ * pushes and pops at the bottom while any other thread may steal from the
+ * top. The capacity is fixed so the deque must never hold more elements than
+ * it was created for.
+ *
+ * Based on the C11 Chase-Lev deque from:
+ * https://fzn.fr/readings/ppopp13.pdf
+ */
+class Deque {
+ public:
+  /**
+   * Creates a deque holding up to capacity elements.
+   */
+  explicit Deque(size_t capacity);
+
+  /**
+   * Pushes an element onto the bottom. Owner only.
+   */
+  void push(int value);
+
+  /**
+   * Pops the bottom element into value. Owner only. Returns false if the deque
+   * was empty.
+   */
+  bool pop(int& value);
+
+  /**
+   * Steals the top element into value. Returns false if the deque was empty
+   * or another thread took the element first.
+   */
+  bool steal(int& value);
+
+ private:
+  /**
+   * Pads the indices onto separate cache lines since the owner mostly writes
+   * bottom and thieves write top.
+   */
+  static constexpr size_t CACHE_LINE = 64;
+
+  std::atomic<int64_t> top;
+
+  char pad0[CACHE_LINE - sizeof(std::atomic<int64_t>)];
+
+  std::atomic<int64_t> bottom;
+
+  char pad1[CACHE_LINE - sizeof(std::atomic<int64_t>)];
+
+  int64_t mask;
+
+  std::unique_ptr<std::atomic<int>[]> buffer;
+};
+
+#endif  // DEQUE_HPP_
@@ -0,0 +1,104 @@
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include "color.hpp"
+#include "image.hpp"
+
+#ifndef FILM_HPP_
+#define FILM_HPP_
+
+/**
+ * Accumulates the samples of every pixel as a sum, a sum of squared
+ * intensities and a count in double precision. Only one thread may add
+ * samples to a pixel at a time, which holds since tiles are rendered by one
+ * worker at a time, but any thread may resolve the film concurrently.
+ *
+ * Each pixel is guarded by a sequence lock so readers retry instead of seeing
+ * a partially added sample and writers never block.
+ */
+class Film {
+ public:
+  /**
+   * Creates a film without samples.
+   */
+  Film(size_t width, size_t height);
+
+  /**
+   * Adds the sum and the sum of squared intensities of the given number of
+   * samples to the (x, y) pixel.
+   */
+  void add(size_t x, size_t y, const Color& sum, double squared,
+           uint32_t samples);
+
+  /**
+   * Returns the number of samples of the (x, y) pixel.
+   */
+  uint32_t samples(size_t x, size_t y) const;
+
+  /**
+   * Returns the standard error of the mean intensity of the (x, y) pixel
+   * relative to the mean. Means below DARK count as DARK so noise in dark
+   * pixels, where it is hardest to see, does not dominate.
+   */
+  double error(size_t x, size_t y) const;
+
+  /**
+   * Returns the average of the samples of every pixel. Pixels without samples
+   * are transparent black.
+   */
+  Image resolve() const;
+
+  /**
+   * Returns the number of samples of every pixel relative to the most
+   * sampled pixel as grayscale.
+   */
+  Image heatmap() const;
+
+  /**
+   * Returns the width of the film.
+   */
+  size_t get_width() const;
+
+  /**
+   * Returns the height of the film.
+   */
+  size_t get_height() const;
+
+  /**
+   * The smallest mean intensity errors are measured relative to.
+   */
+  static constexpr double DARK = 0.05;
+
+ private:
+  struct Pixel {
+    /**
+     * Odd while a writer is adding to the pixel.
+     */
+    std::atomic<uint32_t> sequence;
+
+    std::atomic<uint32_t> samples;
+
+    std::atomic<double> r;
+
+    std::atomic<double> g;
+
+    std::atomic<double> b;
+
+    std::atomic<double> squared;
+  };
+
+  size_t width;
+
+  size_t height;
+
+  std::unique_ptr<Pixel[]> pixels;
+
+  /**
+   * Reads a consistent copy of the sums and count of the pixel.
+   */
+  void read(const Pixel& pixel, double sum[3], double& squared,
+            uint32_t& samples) const;
+};
+
+#endif  // FILM_HPP_
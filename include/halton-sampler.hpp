@@ -0,0 +1,61 @@
+#include <cstdint>
+#include <glm/glm.hpp>
+#include "rng.hpp"
+#include "sampler.hpp"
+
+#ifndef HALTON_SAMPLER_HPP_
+#define HALTON_SAMPLER_HPP_
+
+/**
+ * Halton sequence with the radical inverse of the sample index in the i-th
+ * prime base as the i-th dimension. Every pixel rotates the sequence by
+ * random per dimension offsets (Cranley-Patterson rotation) so neighbouring
+ * pixels do not share the same pattern.
+ *
+ * Large bases correlate badly at low sample counts so dimensions beyond the
+ * first primes fall back to independent random numbers.
+ *
+ * https://pbr-book.org/3ed-2018/Sampling_and_Reconstruction/The_Halton_Sampler
+ */
+class HaltonSampler : public Sampler {
+ public:
+  explicit HaltonSampler(uint64_t seed);
+
+  void start(uint32_t pixel, uint32_t sample) override;
+
+  float next_1d() override;
+
+  glm::vec2 next_2d() override;
+
+ private:
+  /**
+   * The number of leading dimensions taken from the Halton sequence.
+   */
+  static constexpr int DIMENSIONS = 16;
+
+  static const uint32_t PRIMES[DIMENSIONS];
+
+  uint64_t seed;
+
+  uint32_t sample;
+
+  int dimension;
+
+  /**
+   * Draws the offsets of the pixel.
+   */
+  RNG rotation;
+
+  /**
+   * Draws the dimensions beyond the Halton sequence.
+   */
+  RNG rng;
+
+  /**
+   * Returns the digits of the index in the base mirrored about the decimal
+   * point.
+   */
+  static float radical_inverse(uint32_t base, uint32_t index);
+};
+
+#endif  // HALTON_SAMPLER_HPP_
@@ -0,0 +1,28 @@
+#include <cstdint>
+#include <glm/glm.hpp>
+#include "rng.hpp"
+#include "sampler.hpp"
+
+#ifndef INDEPENDENT_SAMPLER_HPP_
+#define INDEPENDENT_SAMPLER_HPP_
+
+/**
+ * Draws every dimension independently from a generator of the sample.
+ */
+class IndependentSampler : public Sampler {
+ public:
+  explicit IndependentSampler(uint64_t seed);
+
+  void start(uint32_t pixel, uint32_t sample) override;
+
+  float next_1d() override;
+
+  glm::vec2 next_2d() override;
+
+ private:
+  uint64_t seed;
+
+  RNG rng;
+};
+
+#endif  // INDEPENDENT_SAMPLER_HPP_
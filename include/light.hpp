@@ -1,6 +1,8 @@
 #include <glm/glm.hpp>
-#include <random>
+#include <memory>
 #include "color.hpp"
+#include "mesh.hpp"
+#include "sampler.hpp"
 
 #ifndef LIGHT_HPP_
 #define LIGHT_HPP_
@@ -10,17 +12,31 @@ class Light {
   struct Sample {
     glm::vec3 P;
 
+    /**
+     * The radiance emitted from P towards the sampled point.
+     */
     Color color;
-  };
 
-  using RNG = std::mt19937;
+    /**
+     * The density of the sample with respect to solid angle at the sampled
+     * point or 0 if the light can not be seen from it.
+     */
+    float pdf;
+  };
 
   virtual ~Light() = default;
 
   /**
-   * Samples the contribution of the light from point P.
+   * Samples a point on the light as seen from point P.
+   */
+  virtual Sample sample(const glm::vec3& P, Sampler& sampler) const = 0;
+
+  /**
+   * Returns a copy of the light which reads from the given copy of the mesh
+   * of the scene.
    */
-  virtual Sample sample(const glm::vec3& P, RNG& rng) const = 0;
+  virtual std::unique_ptr<Light> replicate(
+      std::shared_ptr<const Mesh> mesh) const = 0;
 };
 
 #endif  // LIGHT_HPP_
@@ -0,0 +1,118 @@
+#include <cstdint>
+#include <vector>
+#include "bounding-box.hpp"
+#include "glm/glm.hpp"
+#include "material.hpp"
+#include "ray.hpp"
+#include "vertex.hpp"
+
+#ifndef MESH_HPP_
+#define MESH_HPP_
+
+/**
+ * Indexed triangle mesh stored as structure of arrays. Triangles are addressed
+ * by their 32-bit id which indexes the index and material buffers.
+ */
+class Mesh {
+ public:
+  struct Intersection {
+    /**
+     * The distance to the intersection point. Negative if intersection DNE.
+     */
+    float t = -1;
+
+    /**
+     * The intersection normal.
+     */
+    glm::vec3 N;
+
+    /**
+     * The intersection texture coordinate.
+     */
+    glm::vec2 uv;
+
+    /**
+     * Checks if the intersection exists.
+     */
+    operator bool() const;
+  };
+
+  using NO_INTER = Intersection;
+
+  /**
+   * Vertex positions.
+   */
+  std::vector<glm::vec3> V;
+
+  /**
+   * Vertex normals.
+   */
+  std::vector<glm::vec3> N;
+
+  /**
+   * Texture coordinates.
+   */
+  std::vector<glm::vec2> T;
+
+  std::vector<Material> M;
+
+  /**
+   * The three corners of each triangle.
+   */
+  std::vector<Vertex> indices;
+
+  /**
+   * The material id of each triangle.
+   */
+  std::vector<uint32_t> materials;
+
+  /**
+   * Appends a triangle and returns its id.
+   */
+  uint32_t add(Vertex a, Vertex b, Vertex c, uint32_t m);
+
+  /**
+   * Returns the number of triangles.
+   */
+  uint32_t size() const;
+
+  /**
+   * Returns the intersection result of the triangle and the ray.
+   */
+  Intersection intersects(uint32_t id, const Ray& ray) const;
+
+  /**
+   * Checks if the ray hits the triangle closer than tmax. Unlike
+   * intersects(...) no shading attributes are calculated.
+   */
+  bool occludes(uint32_t id, const Ray& ray, float tmax) const;
+
+  /**
+   * Calculates the shading attributes of a hit at distance t with barycentric
+   * weights u and v of the second and third vertex.
+   */
+  Intersection interpolate(uint32_t id, const Ray& ray, float t, float u,
+                           float v) const;
+
+  /**
+   * Returns the AABB of the triangle.
+   */
+  BoundingBox bounds(uint32_t id) const;
+
+  /**
+   * Returns a reference to the material of the triangle.
+   */
+  const Material& material(uint32_t id) const;
+
+  /**
+   * Returns a boolean indicating if the triangle has texture coordinates.
+   */
+  bool has_texture_coords(uint32_t id) const;
+
+  /**
+   * Returns the position of corner i of the triangle.
+   */
+  const glm::vec3& vert(uint32_t id, int i) const;
+};
+
+#endif  // MESH_HPP_
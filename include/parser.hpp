@@ -1,13 +1,17 @@
 #include <spdlog/spdlog.h>
 #include <tiny_obj_loader.h>
 #include <glm/glm.hpp>
+#include <cstdint>
 #include <memory>
 #include <stdexcept>
 #include <string>
 #include <unordered_map>
+#include <vector>
+#include "cache.hpp"
 #include "color.hpp"
 #include "config.hpp"
 #include "image-loader.hpp"
+#include "mesh.hpp"
 #include "scene.hpp"
 
 #ifndef PARSER_HPP_
@@ -21,8 +25,45 @@ class Parser {
 
   std::unordered_map<std::string, std::shared_ptr<Image>> textures;
 
+  /**
+   * Identifies scene cache files. Bump the version whenever the format of the
+   * cache changes.
+   */
+  static constexpr uint64_t CACHE_MAGIC = 0x4548434143545450ull;
+
+  static constexpr uint64_t CACHE_VERSION = 2;
+
   static std::shared_ptr<spdlog::logger> LOG;
 
+  /**
+   * Hashes the contents of the scene file and the material libraries it
+   * references together with the loader and BVH config.
+   */
+  uint64_t cache_key(const std::string& scene_file,
+                     const std::string& materials_path) const;
+
+  /**
+   * Loads the scene from a cache file. Returns false if the cache was created
+   * from different inputs and throws std::runtime_error if it is unreadable.
+   */
+  bool load_cache(const std::string& cache_file, uint64_t key, Scene& scene);
+
+  /**
+   * Writes the scene to a cache file. The diffuse texture file of each
+   * material is stored so textures can be reloaded. Throws std::runtime_error
+   * on failure.
+   */
+  void save_cache(const std::string& cache_file, uint64_t key,
+                  const Scene& scene,
+                  const std::vector<std::string>& texture_files) const;
+
+  /**
+   * Adds an area light for every emissive triangle of the mesh.
+   */
+  static void add_lights(Scene& scene, std::shared_ptr<const Mesh> mesh);
+
+  static void log_bounds(const Scene& scene);
+
   static Color to_color(const tinyobj::real_t* color);
 
   static glm::vec3 to_vec(const tinyobj::real_t* vec);
@@ -33,6 +74,8 @@ class Parser {
   /**
    * Parses an OBJ file into a scene object. The OBJ material loaders is
    * finicky so ensure the material base directory contains a trailing slash.
+   * The scene is loaded from and written to the cache directory of the loader
+   * config if one is set.
    */
   Scene parse(std::string scene_file,
               std::string materials_path) throw(std::logic_error);
@@ -1,28 +1,81 @@
-#include <random>
+#include "bvh.hpp"
 #include "color.hpp"
 #include "config.hpp"
 #include "ray.hpp"
+#include "sampler.hpp"
 #include "scene.hpp"
 
 #ifndef PATHTRACER_HPP_
 #define PATHTRACER_HPP_
 
 class PathTracer {
+ public:
+  /**
+   * State of a path between two bounces.
+   */
+  struct Path {
+    /**
+     * The ray leaving the last vertex of the path.
+     */
+    Ray ray;
+
+    /**
+     * The factor the radiance arriving along the ray is scaled by before it
+     * reaches the camera.
+     */
+    Color throughput;
+
+    /**
+     * The radiance gathered so far.
+     */
+    Color radiance;
+
+    int depth;
+
+    /**
+     * Emission is only counted for rays which do not end a direct light
+     * sample.
+     */
+    bool emission;
+
+    /**
+     * The density with respect to solid angle the ray was sampled with if
+     * emission it finds is weighed against direct light samples, otherwise 0
+     * to count the emission in full.
+     */
+    float pdf;
+  };
+
+  /**
+   * Shadow ray of a direct light sample. The contribution is added to the
+   * path radiance if nothing blocks the ray closer than tmax, which is not
+   * positive if there is no shadow ray.
+   */
+  struct Shadow {
+    glm::vec3 O;
+
+    glm::vec3 D;
+
+    float tmax = 0;
+
+    Color contribution;
+  };
+
  private:
   enum Shading { NONE, DIFF, REFL_ONLY, REFL_REFR };
 
   Config config;
 
-  mutable std::mt19937 gen;
-
-  Color trace(const Scene& scene, const Ray& ray, int depth,
-              bool emission) const;
+  /**
+   * Returns the perfect reflection of the incident direction I.
+   */
+  glm::vec3 mirror(const glm::vec3& N, const glm::vec3& I) const;
 
   /**
    * Generates a reflection ray.
    */
-  glm::vec3 reflect(const glm::vec3& N, const glm::vec3& I,
-                    float roughness) const;
+  glm::vec3 reflect(const glm::vec3& N, const glm::vec3& I, float roughness,
+                    Sampler& sampler) const;
 
   /**
    * Calculates the reflection factor using the fresnel formula.
@@ -37,12 +90,23 @@ class PathTracer {
   glm::vec3 refract(const glm::vec3& N, const glm::vec3& I, float ior) const;
 
   /**
-   * Returns the direct lighting contribution of directly sampling a light
-   * source from position P with normal N. The contribution is scaled by the
-   * PDF = 1 / |Lights| of a uniform sample.
+   * Returns the shadow ray and the unoccluded direct lighting contribution of
+   * directly sampling a light source from position P with normal N. The light
+   * is chosen uniformly and reflected by a BSDF whose product with the cosine
+   * is the density of var_cos_weighted_hemi around axis with the given
+   * spread, which leaves out the color of the surface. With MIS the sample is
+   * weighed against reflected rays finding the same light.
+   */
+  Shadow direct_light_sample(const Scene& scene, const glm::vec3& P,
+                             const glm::vec3& N, const glm::vec3& axis,
+                             float spread, Sampler& sampler) const;
+
+  /**
+   * Returns the density with respect to solid angle of direct_light_sample
+   * choosing point X of the light triangle from P.
    */
-  Color direct_light_sample(const Scene& scene, const glm::vec3& P,
-                            const glm::vec3& N) const;
+  float light_pdf(const Scene& scene, uint32_t triangle, const glm::vec3& P,
+                  const glm::vec3& X) const;
 
  public:
   /**
@@ -51,9 +115,28 @@ class PathTracer {
   explicit PathTracer(Config config);
 
   /**
-   * Calculates the color of shooting this ray into the scene.
+   * Calculates the color of shooting this ray into the scene. Random numbers
+   * are drawn from the sample started by the sampler.
+   *
+   * The path is followed in a loop which adds the light found at each vertex
+   * scaled by the throughput of the path so far, so the stack does not grow
+   * with the path length.
+   */
+  Color trace(const Scene& scene, const Ray& ray, Sampler& sampler) const;
+
+  /**
+   * Returns a path starting with the camera ray.
+   */
+  Path start(const Ray& ray) const;
+
+  /**
+   * Shades the intersection of the ray of the path. Adds the light found at
+   * the intersection to the path and continues it with the next ray. A direct
+   * light sample is returned as a shadow ray to be tested by the caller
+   * before the next call. Returns false once the path has ended.
    */
-  Color trace(const Scene& scene, const Ray& ray) const;
+  bool shade(const Scene& scene, const BVH::Intersection& inter, Path& path,
+             Shadow& shadow, Sampler& sampler) const;
 };
 
 #endif  // PATHTRACER_HPP_
@@ -8,8 +8,19 @@ struct Ray {
 
   glm::vec3 D;
 
+  /**
+   * Component-wise inverse of the direction used by slab tests.
+   */
+  glm::vec3 invD;
+
   Ray(const glm::vec3& O, const glm::vec3& D);
 
+  /**
+   * Creates a ray from a normalized direction and its inverse as stored by
+   * another ray, without normalizing the direction again.
+   */
+  Ray(const glm::vec3& O, const glm::vec3& D, const glm::vec3& invD);
+
   glm::vec3 at(float t) const;
 };
 
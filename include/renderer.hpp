@@ -22,6 +22,11 @@ class Renderer {
  private:
   static std::shared_ptr<spdlog::logger> LOG;
 
+  /**
+   * Returns the path of the sample heatmap saved next to the output.
+   */
+  static std::string heatmap(const std::string& output);
+
   Config config;
 
   const ImageSaver& saver;
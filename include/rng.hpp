@@ -0,0 +1,102 @@
+#include <cstdint>
+#include <limits>
+
+#ifndef RNG_HPP_
+#define RNG_HPP_
+
+/**
+ * Small and fast PCG32 random number generator. Every sample of a pixel draws
+ * from its own generator so no generator state is shared between threads.
+ * Generators with the same seed but different streams produce independent
+ * sequences.
+ *
+ * Satisfies UniformRandomBitGenerator so it also works with the standard
+ * distributions.
+ *
+ * http://www.pcg-random.org/
+ */
+class RNG {
+ public:
+  using result_type = uint32_t;
+
+  /**
+   * Creates a generator for the stream of the given seed.
+   */
+  explicit RNG(uint64_t seed = 0x853c49e6748fea9bULL, uint64_t stream = 0)
+      : state(0), increment((stream << 1) | 1) {
+    (*this)();
+    state += seed;
+    (*this)();
+  }
+
+  /**
+   * Returns the generator of a sample of a pixel. The same seed, pixel and
+   * sample always give the same sequence which makes renders reproducible
+   * regardless of which thread takes the sample.
+   */
+  static RNG sample(uint64_t seed, uint32_t pixel, uint32_t sample) {
+    uint64_t key = (static_cast<uint64_t>(pixel) << 32) | sample;
+    return RNG(mix(seed ^ mix(key)), pixel);
+  }
+
+  /**
+   * Returns the generator of a pixel which is the same for all its samples.
+   * Low discrepancy samplers draw the scrambles of the pixel from it.
+   */
+  static RNG pixel(uint64_t seed, uint32_t pixel) {
+    return RNG(mix(mix(seed) + pixel), pixel);
+  }
+
+  /**
+   * Returns the next 32 random bits.
+   */
+  uint32_t operator()() {
+    uint64_t old = state;
+    state = old * 6364136223846793005ULL + increment;
+
+    uint32_t shifted = static_cast<uint32_t>(((old >> 18) ^ old) >> 27);
+    uint32_t rotation = static_cast<uint32_t>(old >> 59);
+    return (shifted >> rotation) | (shifted << ((-rotation) & 31));
+  }
+
+  /**
+   * Returns a float uniformly distributed in [0, 1). The top 24 bits fill the
+   * mantissa exactly so 1 is never returned.
+   */
+  float uniform() {
+    return ((*this)() >> 8) * (1.0f / 16777216.0f);
+  }
+
+  /**
+   * Returns an integer uniformly distributed in [0, n) using a multiply and
+   * shift instead of a division. The bias is negligible for small n.
+   */
+  uint32_t bounded(uint32_t n) {
+    return static_cast<uint32_t>((static_cast<uint64_t>((*this)()) * n) >> 32);
+  }
+
+  static constexpr result_type min() {
+    return 0;
+  }
+
+  static constexpr result_type max() {
+    return std::numeric_limits<result_type>::max();
+  }
+
+ private:
+  uint64_t state;
+
+  uint64_t increment;
+
+  /**
+   * Scrambles the bits of x with the SplitMix64 finalizer so nearby keys
+   * give unrelated seeds.
+   */
+  static uint64_t mix(uint64_t x) {
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+  }
+};
+
+#endif  // RNG_HPP_
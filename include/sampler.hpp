@@ -0,0 +1,47 @@
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <memory>
+#include "config.hpp"
+
+#ifndef SAMPLER_HPP_
+#define SAMPLER_HPP_
+
+/**
+ * Source of the random numbers of a sample of a pixel. Every call returns the
+ * next dimension of the sample point. Low discrepancy samplers spread the
+ * points of all samples of a pixel evenly over each dimension so renders
+ * converge with fewer samples than with independent random numbers.
+ */
+class Sampler {
+ public:
+  virtual ~Sampler() = default;
+
+  /**
+   * Starts the sample of the pixel and resets the dimension to the first.
+   */
+  virtual void start(uint32_t pixel, uint32_t sample) = 0;
+
+  /**
+   * Returns the next dimension of the sample in [0, 1).
+   */
+  virtual float next_1d() = 0;
+
+  /**
+   * Returns the next two dimensions of the sample in [0, 1). Both come from
+   * the same stratified pattern so pairs which are warped together, such as
+   * directions and points on a light, should be drawn with this.
+   */
+  virtual glm::vec2 next_2d() = 0;
+
+  /**
+   * Returns an integer in [0, n) from the next dimension of the sample.
+   */
+  uint32_t bounded(uint32_t n);
+
+  /**
+   * Creates the sampler named by the rendering config.
+   */
+  static std::unique_ptr<Sampler> create(const Config& config);
+};
+
+#endif  // SAMPLER_HPP_
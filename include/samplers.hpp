@@ -1,6 +1,6 @@
 #include <cassert>
 #include <glm/glm.hpp>
-#include <random>
+#include "sampler.hpp"
 
 #ifndef SAMPLERS_HPP_
 #define SAMPLERS_HPP_
@@ -52,10 +52,9 @@ inline vec3 cos_weighted_hemi(const vec3& N, float s, float t) {
  * https://www.scratchapixel.com/lessons/3d-basic-rendering/global-illumination-path-tracing/global-illumination-path-tracing-practical-implementation
  * https://cseweb.ucsd.edu/classes/sp17/cse168-a/CSE168_07_Random.pdf
  */
-template <typename RNG>
-inline vec3 cos_weighted_hemi(const vec3& N, RNG& rng) {
-  static std::uniform_real_distribution<float> dist(0, 1);
-  return cos_weighted_hemi(N, dist(rng), dist(rng));
+inline vec3 cos_weighted_hemi(const vec3& N, Sampler& sampler) {
+  glm::vec2 st = sampler.next_2d();
+  return cos_weighted_hemi(N, st.x, st.y);
 }
 
 /**
@@ -63,31 +62,58 @@ inline vec3 cos_weighted_hemi(const vec3& N, RNG& rng) {
  * factor should be in the range [0, 1] and is used to control how clustered
  * towards the center of the hemisphere the generated vectors are.
  */
-template <typename RNG>
-inline vec3 var_cos_weighted_hemi(const vec3& N, float var, RNG& rng) {
-  static std::uniform_real_distribution<float> dist(0, 1);
-
+inline vec3 var_cos_weighted_hemi(const vec3& N, float var,
+                                  Sampler& sampler) {
   assert(var >= 0 && var <= 1);
 
-  float t = 1 - dist(rng) * var;
-  return cos_weighted_hemi(N, dist(rng), t);
+  glm::vec2 st = sampler.next_2d();
+  return cos_weighted_hemi(N, st.x, 1 - st.y * var);
 }
 
 /**
- * Uniformly samples a point from triangle ABC using rejection sampling.
- *
- * http://www.joesfer.com/?p=84
+ * Returns the density with respect to solid angle of var_cos_weighted_hemi
+ * generating direction D. The squared cosine of its samples to N is uniform
+ * in [1 - var, 1] so the density is cos / (PI * var) within that cone.
  */
-template <typename RNG>
-inline vec3 triangle(const vec3& A, const vec3& B, const vec3& C, RNG& rng) {
-  static std::uniform_real_distribution<float> dist(0, 1);
+inline float var_cos_weighted_hemi_pdf(const vec3& N, float var,
+                                       const vec3& D) {
+  float cos = glm::dot(N, D);
+  if (var <= 0 || cos <= 0 || cos * cos < 1 - var) {
+    return 0;
+  }
+  return cos / (PI * var);
+}
 
-  float u, v;
+/**
+ * Returns the multiple importance sampling weight of a sample drawn with
+ * density pdf against another strategy with density other using the power
+ * heuristic with an exponent of 2.
+ *
+ * https://graphics.stanford.edu/courses/cs348b-03/papers/veach-chapter9.pdf
+ */
+inline float power_heuristic(float pdf, float other) {
+  float a = pdf * pdf;
+  float b = other * other;
+  return a + b > 0 ? a / (a + b) : 0;
+}
 
-  do {
-    u = dist(rng);
-    v = dist(rng);
-  } while (u + v > 1);
+/**
+ * Uniformly samples a point from triangle ABC. Points of the unit square
+ * beyond the diagonal are mirrored back instead of rejected so stratified
+ * sample points stay stratified.
+ *
+ * http://www.joesfer.com/?p=84
+ */
+inline vec3 triangle(const vec3& A, const vec3& B, const vec3& C,
+                     Sampler& sampler) {
+  glm::vec2 uv = sampler.next_2d();
+  float u = uv.x;
+  float v = uv.y;
+
+  if (u + v > 1) {
+    u = 1 - u;
+    v = 1 - v;
+  }
 
   float w = 1 - u - v;
 
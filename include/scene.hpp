@@ -12,7 +12,19 @@ struct Scene {
 
   BVH bvh;
 
+  /**
+   * One area light per emissive triangle of the mesh, as added by the
+   * parser. The path tracer relies on this to weigh emission it hits against
+   * direct light samples, which choose among the lights uniformly.
+   */
   std::vector<std::unique_ptr<Light>> lights;
+
+  /**
+   * Returns a deep copy of the scene including its mesh and textures. The
+   * copy is written by the calling thread so a thread pinned to a NUMA node
+   * gets a copy in the memory of that node.
+   */
+  Scene replicate() const;
 };
 
 #endif  // SCENE_HPP_
@@ -0,0 +1,98 @@
+#include <algorithm>
+#include <glm/glm.hpp>
+#include <limits>
+
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif
+
+#ifdef __AVX__
+#include <immintrin.h>
+#endif
+
+#ifndef SIMD_HPP_
+#define SIMD_HPP_
+
+namespace simd {
+/**
+ * Slab tests a ray against W boxes stored in structure of arrays form as
+ * min x, min y, min z, max x, max y, max z. The entry distance of each box is
+ * written to tnear and a bit mask of the boxes hit within [0, tmax] returned.
+ *
+ * This is the portable fallback used when no vectorized version exists.
+ */
+template <int W>
+inline int slabs(const float (&bounds)[6][W], const glm::vec3& O,
+                 const glm::vec3& invD, float tmax, float* tnear) {
+  int mask = 0;
+
+  for (int i = 0; i < W; i++) {
+    float entry = 0;
+    float exit = tmax;
+
+    for (int axis = 0; axis < 3; axis++) {
+      float t0 = (bounds[axis][i] - O[axis]) * invD[axis];
+      float t1 = (bounds[axis + 3][i] - O[axis]) * invD[axis];
+      entry = std::max(entry, std::min(t0, t1));
+      exit = std::min(exit, std::max(t0, t1));
+    }
+
+    tnear[i] = entry;
+    mask |= (entry <= exit) << i;
+  }
+
+  return mask;
+}
+
+#ifdef __SSE__
+/**
+ * Tests 4 boxes at once with SSE.
+ */
+template <>
+inline int slabs<4>(const float (&bounds)[6][4], const glm::vec3& O,
+                    const glm::vec3& invD, float tmax, float* tnear) {
+  __m128 entry = _mm_setzero_ps();
+  __m128 exit = _mm_set1_ps(tmax);
+
+  for (int axis = 0; axis < 3; axis++) {
+    __m128 o = _mm_set1_ps(O[axis]);
+    __m128 d = _mm_set1_ps(invD[axis]);
+    __m128 t0 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(bounds[axis]), o), d);
+    __m128 t1 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(bounds[axis + 3]), o), d);
+    entry = _mm_max_ps(entry, _mm_min_ps(t0, t1));
+    exit = _mm_min_ps(exit, _mm_max_ps(t0, t1));
+  }
+
+  _mm_storeu_ps(tnear, entry);
+  return _mm_movemask_ps(_mm_cmple_ps(entry, exit));
+}
+#endif
+
+#ifdef __AVX__
+/**
+ * Tests 8 boxes at once with AVX.
+ */
+template <>
+inline int slabs<8>(const float (&bounds)[6][8], const glm::vec3& O,
+                    const glm::vec3& invD, float tmax, float* tnear) {
+  __m256 entry = _mm256_setzero_ps();
+  __m256 exit = _mm256_set1_ps(tmax);
+
+  for (int axis = 0; axis < 3; axis++) {
+    __m256 o = _mm256_set1_ps(O[axis]);
+    __m256 d = _mm256_set1_ps(invD[axis]);
+    __m256 t0 =
+        _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(bounds[axis]), o), d);
+    __m256 t1 =
+        _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(bounds[axis + 3]), o), d);
+    entry = _mm256_max_ps(entry, _mm256_min_ps(t0, t1));
+    exit = _mm256_min_ps(exit, _mm256_max_ps(t0, t1));
+  }
+
+  _mm256_storeu_ps(tnear, entry);
+  return _mm256_movemask_ps(_mm256_cmp_ps(entry, exit, _CMP_LE_OQ));
+}
+#endif
+}  // namespace simd
+
+#endif  // SIMD_HPP_
@@ -0,0 +1,54 @@
+#include <cstdint>
+#include <glm/glm.hpp>
+#include "rng.hpp"
+#include "sampler.hpp"
+
+#ifndef SOBOL_SAMPLER_HPP_
+#define SOBOL_SAMPLER_HPP_
+
+/**
+ * Owen scrambled Sobol points. Each pair of dimensions is taken from the
+ * first two Sobol dimensions, which form a (0, 2) sequence, with its own
+ * shuffle of the sample index and its own scramble. The points of every
+ * power of two prefix of samples are stratified in each pair while pairs stay
+ * uncorrelated with each other.
+ *
+ * Based on "Practical Hash-based Owen Scrambling" by Brent Burley:
+ * https://jcgt.org/published/0009/04/01/
+ */
+class SobolSampler : public Sampler {
+ public:
+  explicit SobolSampler(uint64_t seed);
+
+  void start(uint32_t pixel, uint32_t sample) override;
+
+  float next_1d() override;
+
+  glm::vec2 next_2d() override;
+
+ private:
+  uint64_t seed;
+
+  uint32_t sample;
+
+  /**
+   * Draws the shuffle and scramble seeds of every dimension of the pixel.
+   */
+  RNG scramble;
+
+  /**
+   * Returns the first or second Sobol dimension of the index as a fixed point
+   * fraction.
+   */
+  static uint32_t sobol(uint32_t index, int dimension);
+
+  /**
+   * Owen scrambles the fixed point fraction by hashing each bit together with
+   * the bits above it.
+   */
+  static uint32_t owen(uint32_t x, uint32_t seed);
+
+  static uint32_t reverse(uint32_t x);
+};
+
+#endif  // SOBOL_SAMPLER_HPP_
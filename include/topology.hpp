@@ -0,0 +1,62 @@
+#include <string>
+#include <vector>
+
+#ifndef TOPOLOGY_HPP_
+#define TOPOLOGY_HPP_
+
+/**
+ * The CPUs the process may run on grouped by NUMA node. Used to pin render
+ * threads to cores and to place a copy of the scene on every node.
+ *
+ * The topology is read from sysfs on Linux. Elsewhere, or if sysfs is not
+ * available, all CPUs are reported on a single node and pinning is a no-op.
+ */
+class Topology {
+ public:
+  /**
+   * The ids of the CPUs of each node. Nodes without usable CPUs are left out.
+   */
+  std::vector<std::vector<int>> nodes;
+
+  /**
+   * Creates a topology of the given nodes.
+   */
+  explicit Topology(std::vector<std::vector<int>> nodes);
+
+  /**
+   * Detects the topology of the CPUs the process may run on.
+   */
+  static Topology detect();
+
+  /**
+   * Returns the total number of CPUs.
+   */
+  int cpus() const;
+
+  /**
+   * Returns the index of the node of the CPU or 0 if it is unknown.
+   */
+  int node(int cpu) const;
+
+  /**
+   * Returns the CPU each of the given number of threads is pinned to. The
+   * "compact" affinity fills the CPUs of one node before moving to the next
+   * while "scatter" deals the threads out to the nodes in turn. Threads are
+   * not pinned, which is marked as -1, for "none". CPUs are reused once every
+   * CPU has a thread.
+   */
+  std::vector<int> place(int threads, const std::string& affinity) const;
+
+  /**
+   * Pins the calling thread to the CPU. Returns false if pinning is not
+   * supported or failed.
+   */
+  static bool pin(int cpu);
+
+  /**
+   * Parses a sysfs CPU list like "0-3,8,10-11".
+   */
+  static std::vector<int> parse(const std::string& list);
+};
+
+#endif  // TOPOLOGY_HPP_
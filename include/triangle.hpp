@@ -1,53 +1,199 @@
-#include <memory>
-#include <vector>
-#include "glm/glm.hpp"
-#include "material.hpp"
-#include "primitive.hpp"
-#include "vertex.hpp"
+#include <cmath>
+#include <glm/glm.hpp>
+#include <utility>
+#include "ray.hpp"
 
 #ifndef TRIANGLE_HPP_
 #define TRIANGLE_HPP_
 
-class Triangle : public Primitive {
- public:
-  template <typename T>
-  using SharedAttrib = std::shared_ptr<std::vector<T>>;
-
-  Vertex a;
-
-  Vertex b;
-
-  Vertex c;
-
-  size_t m;
-
-  SharedAttrib<glm::vec3> V;
-
-  SharedAttrib<glm::vec3> N;
-
-  SharedAttrib<Material> M;
-
-  SharedAttrib<glm::vec2> T;
-
-  BoundingBox box;
-
-  Triangle(Vertex a, Vertex b, Vertex c, size_t m, SharedAttrib<glm::vec3> V,
-           SharedAttrib<glm::vec3> N, SharedAttrib<Material> M,
-           SharedAttrib<glm::vec2> T);
-
-  Intersection intersects(const Ray& ray) const override;
-
-  const BoundingBox& bounds() const override;
-
-  const Material& material() const override;
-
-  bool has_texture_coords() const override;
-
-  glm::vec3 vert(size_t i) const;
-
-  glm::vec3 norm(size_t i) const;
-
-  glm::vec2 tex(size_t i) const;
+/**
+ * Compact triangle record tested by the intersection kernels. Records are
+ * precomputed from the mesh when the BVH is built and stored in leaf order so
+ * a leaf is tested without touching the index or position buffers.
+ *
+ * The Moller-Trumbore kernel stores the first vertex and the two edges from
+ * it. The watertight kernel stores the three vertices since edges computed
+ * from different vertices of a shared edge would not match exactly.
+ */
+struct Triangle {
+  /**
+   * Distance to the hit and the barycentric weights of the second and third
+   * vertex.
+   */
+  struct Hit {
+    float t;
+
+    float u;
+
+    float v;
+  };
+
+  /**
+   * Per ray constants of the watertight kernel. The ray is transformed so it
+   * points along the z axis and starts at the origin.
+   */
+  struct Shear {
+    int kx;
+
+    int ky;
+
+    int kz;
+
+    float Sx;
+
+    float Sy;
+
+    float Sz;
+
+    Shear() = default;
+
+    explicit Shear(const Ray& ray);
+  };
+
+  glm::vec3 a;
+
+  glm::vec3 b;
+
+  glm::vec3 c;
+
+  /**
+   * Creates a record for the Moller-Trumbore kernel.
+   */
+  static Triangle edges(const glm::vec3& a, const glm::vec3& b,
+                        const glm::vec3& c);
+
+  /**
+   * Creates a record for the watertight kernel.
+   */
+  static Triangle vertices(const glm::vec3& a, const glm::vec3& b,
+                           const glm::vec3& c);
+
+  /**
+   * Moller-Trumbore test of an edges(...) record. Writes the hit if the ray
+   * hits the triangle in [0, tmax).
+   *
+   * https://cadxfem.org/inf/Fast%20MinimumStorage%20RayTriangle%20Intersection.pdf
+   */
+  bool intersect(const Ray& ray, float tmax, Hit& hit) const;
+
+  /**
+   * Watertight test of a vertices(...) record which never misses a ray
+   * passing exactly through a shared edge or vertex. Writes the hit if the
+   * ray hits the triangle in [0, tmax).
+   *
+   * http://jcgt.org/published/0002/01/05/paper.pdf
+   */
+  bool intersect(const Ray& ray, const Shear& shear, float tmax,
+                 Hit& hit) const;
 };
 
+inline Triangle::Shear::Shear(const Ray& ray) {
+  glm::vec3 D = glm::abs(ray.D);
+  kz = D.x > D.y ? (D.x > D.z ? 0 : 2) : (D.y > D.z ? 1 : 2);
+  kx = (kz + 1) % 3;
+  ky = (kx + 1) % 3;
+
+  // Preserve the winding of the triangles.
+  if (ray.D[kz] < 0) {
+    std::swap(kx, ky);
+  }
+
+  Sx = ray.D[kx] / ray.D[kz];
+  Sy = ray.D[ky] / ray.D[kz];
+  Sz = 1.0f / ray.D[kz];
+}
+
+inline Triangle Triangle::edges(const glm::vec3& a, const glm::vec3& b,
+                                const glm::vec3& c) {
+  return Triangle{a, b - a, c - a};
+}
+
+inline Triangle Triangle::vertices(const glm::vec3& a, const glm::vec3& b,
+                                   const glm::vec3& c) {
+  return Triangle{a, b, c};
+}
+
+inline bool Triangle::intersect(const Ray& ray, float tmax, Hit& hit) const {
+  glm::vec3 P = glm::cross(ray.D, c);
+  float det = glm::dot(b, P);
+
+  // Check if ray is parallel to plane of triangle
+  if (det == 0) {
+    return false;
+  }
+
+  float inv = 1.0f / det;
+  glm::vec3 S = ray.O - a;
+
+  float u = glm::dot(S, P) * inv;
+  if (u < 0 || u > 1) {
+    return false;
+  }
+
+  glm::vec3 Q = glm::cross(S, b);
+
+  float v = glm::dot(ray.D, Q) * inv;
+  if (v < 0 || u + v > 1) {
+    return false;
+  }
+
+  float t = glm::dot(c, Q) * inv;
+  if (t < 0 || t >= tmax) {
+    return false;
+  }
+
+  hit = Hit{t, u, v};
+  return true;
+}
+
+inline bool Triangle::intersect(const Ray& ray, const Shear& shear, float tmax,
+                                Hit& hit) const {
+  glm::vec3 A = a - ray.O;
+  glm::vec3 B = b - ray.O;
+  glm::vec3 C = c - ray.O;
+
+  float Ax = A[shear.kx] - shear.Sx * A[shear.kz];
+  float Ay = A[shear.ky] - shear.Sy * A[shear.kz];
+  float Bx = B[shear.kx] - shear.Sx * B[shear.kz];
+  float By = B[shear.ky] - shear.Sy * B[shear.kz];
+  float Cx = C[shear.kx] - shear.Sx * C[shear.kz];
+  float Cy = C[shear.ky] - shear.Sy * C[shear.kz];
+
+  // Scaled barycentric weights of a, b and c.
+  float U = Cx * By - Cy * Bx;
+  float V = Ax * Cy - Ay * Cx;
+  float W = Bx * Ay - By * Ax;
+
+  // Fall back to double precision for rays through an edge.
+  if (U == 0 || V == 0 || W == 0) {
+    U = static_cast<double>(Cx) * By - static_cast<double>(Cy) * Bx;
+    V = static_cast<double>(Ax) * Cy - static_cast<double>(Ay) * Cx;
+    W = static_cast<double>(Bx) * Ay - static_cast<double>(By) * Ax;
+  }
+
+  if ((U < 0 || V < 0 || W < 0) && (U > 0 || V > 0 || W > 0)) {
+    return false;
+  }
+
+  float det = U + V + W;
+  if (det == 0) {
+    return false;
+  }
+
+  float Az = shear.Sz * A[shear.kz];
+  float Bz = shear.Sz * B[shear.kz];
+  float Cz = shear.Sz * C[shear.kz];
+  float T = U * Az + V * Bz + W * Cz;
+
+  // Compare the scaled distance to avoid dividing for misses.
+  float sign = std::copysign(1.0f, det);
+  if (T * sign < 0 || T * sign >= tmax * det * sign) {
+    return false;
+  }
+
+  float inv = 1.0f / det;
+  hit = Hit{T * inv, V * inv, W * inv};
+  return true;
+}
+
 #endif  // TRIANGLE_HPP_
@@ -0,0 +1,166 @@
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+#include "color.hpp"
+#include "config.hpp"
+#include "film.hpp"
+#include "pathtracer.hpp"
+#include "sampler.hpp"
+#include "scene.hpp"
+
+#ifndef WAVEFRONT_HPP_
+#define WAVEFRONT_HPP_
+
+/**
+ * Path tracing integrator which keeps every sample of a tile in flight at once
+ * instead of tracing one path at a time. The paths advance bounce by bounce
+ * in stages which each run over all paths before the next stage starts:
+ *
+ * 1. Generate the camera rays of all samples.
+ * 2. Intersect the rays of the active paths with the scene. Camera rays are
+ *    traced in packets.
+ * 3. Shade the hits, which ends paths or queues their next ray and a shadow
+ *    ray for the direct light sample.
+ * 4. Test the queued shadow rays and add the light of unoccluded ones.
+ *
+ * Optionally the secondary rays are sorted by direction octant and origin
+ * before they are intersected and the hits by material before they are
+ * shaded. Paths do not depend on the order they are processed in so sorting
+ * does not change the image.
+ *
+ * Rays, hits and path state are stored as structures of arrays so each stage
+ * streams through the fields it needs. Every path draws from its own sampler
+ * in the same order as PathTracer::trace so both integrators render the same
+ * image.
+ */
+class Wavefront {
+ public:
+  /**
+   * Creates a configured wavefront integrator.
+   */
+  explicit Wavefront(Config config);
+
+  /**
+   * Traces batch samples of every pixel in [begin, end), starting at the
+   * given sample index, and adds them to the film.
+   */
+  void render(const Scene& scene, glm::ivec2 begin, glm::ivec2 end,
+              uint32_t first, int batch, Film& film);
+
+ private:
+  Config config;
+
+  PathTracer pathtracer;
+
+  /**
+   * The sampler of each path.
+   */
+  std::vector<std::unique_ptr<Sampler>> samplers;
+
+  /**
+   * The rays of the paths.
+   */
+  std::vector<glm::vec3> O;
+
+  std::vector<glm::vec3> D;
+
+  std::vector<glm::vec3> invD;
+
+  /**
+   * The closest hit of each ray. Misses have a negative distance.
+   */
+  std::vector<float> t;
+
+  std::vector<glm::vec3> N;
+
+  std::vector<glm::vec2> uv;
+
+  std::vector<uint32_t> triangle;
+
+  /**
+   * The state of the paths.
+   */
+  std::vector<Color> throughput;
+
+  std::vector<Color> radiance;
+
+  std::vector<int> depth;
+
+  std::vector<uint8_t> emission;
+
+  std::vector<float> pdf;
+
+  /**
+   * The indices of the paths which are still bouncing and of those which
+   * continue after the current bounce.
+   */
+  std::vector<uint32_t> active;
+
+  std::vector<uint32_t> next;
+
+  /**
+   * The queued shadow rays, their contributions and the paths they add to.
+   */
+  std::vector<glm::vec3> shadow_O;
+
+  std::vector<glm::vec3> shadow_D;
+
+  std::vector<float> shadow_tmax;
+
+  std::vector<Color> shadow_contribution;
+
+  std::vector<uint32_t> shadow_path;
+
+  /**
+   * The rays of the packet being intersected.
+   */
+  std::vector<Ray> rays;
+
+  /**
+   * Sort keys of the active paths.
+   */
+  std::vector<std::pair<uint64_t, uint32_t>> keys;
+
+  /**
+   * Returns the ray of the path.
+   */
+  Ray ray(uint32_t path) const;
+
+  /**
+   * Creates the camera rays of the batch samples of every pixel.
+   */
+  void generate(const Scene& scene, glm::ivec2 begin, glm::ivec2 end,
+                uint32_t first, int batch);
+
+  /**
+   * Orders the active paths by the direction octant of their ray and by the
+   * Morton code of its origin within the scene bounds.
+   */
+  void sort_rays(const Scene& scene);
+
+  /**
+   * Orders the active paths by the material of their hit. Misses go last and
+   * paths with the same material stay in ray order.
+   */
+  void sort_hits(const Scene& scene);
+
+  /**
+   * Finds the closest hit of the ray of every active path. Primary rays are
+   * intersected in packets.
+   */
+  void intersect(const Scene& scene, bool primary);
+
+  /**
+   * Shades the hits of the active paths and queues their shadow rays.
+   */
+  void shade(const Scene& scene);
+
+  /**
+   * Adds the contribution of every unoccluded shadow ray to its path.
+   */
+  void shadow(const Scene& scene);
+};
+
+#endif  // WAVEFRONT_HPP_
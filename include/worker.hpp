@@ -1,10 +1,15 @@
 #include <atomic>
-#include <mutex>
-#include <queue>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <limits>
+#include <memory>
+#include <string>
 #include <vector>
 #include "config.hpp"
-#include "image.hpp"
+#include "deque.hpp"
+#include "film.hpp"
 #include "pathtracer.hpp"
+#include "sampler.hpp"
 #include "scene.hpp"
 
 #ifndef WORKER_HPP_
@@ -13,51 +18,164 @@
 class Worker {
  public:
   /**
-   * Region of the image from the begin (inclusive) to end (exclusive) pixel.
+   * Rectangle of the image from the begin (inclusive) to end (exclusive)
+   * corner.
    */
   struct Work {
-    int begin;
+    glm::ivec2 begin;
 
-    int end;
+    glm::ivec2 end;
 
     int samples;
-
-    bool operator>(const Work& other) const;
   };
 
   /**
-   * Thread safe queue that prioritizes partitions with less samples.
+   * Splits the image into square tiles of the given size. The tiles are
+   * ordered row by row for "scanline" or along a "morton" or "hilbert" curve
+   * so consecutive tiles are neighbours in the image.
+   */
+  static std::vector<Work> tiles(int width, int height, int size,
+                                 const std::string& order);
+
+  /**
+   * Returns the number of samples taken of each pixel of a tile each time it
+   * is dequeued. A time limit takes one at a time so every pixel stops within
+   * one sample of the others.
+   */
+  static int batch(const Config& config);
+
+  /**
+   * Returns whether the queue must finish every pass before the next starts,
+   * which the time limit and the adaptive budget rely on.
+   */
+  static bool strict(const Config& config);
+
+  /**
+   * Lock-free queue that prioritizes tiles with less samples. Each thread
+   * owns a work stealing deque per parity of the sample pass. All threads
+   * consume the deques of the current sample pass, stealing from each other
+   * when they run out, and push finished work for the next pass onto the
+   * other deque. The pass advances once no work of the current pass is queued
+   * so tiles are sampled in the same order as by a priority queue, except
+   * that a few may lag by one pass under contention. A strict queue advances
+   * only once all work of the current pass is finished so no tile is ever
+   * more than one pass ahead of another, at the cost of idle threads at the
+   * end of every pass.
    */
   class Queue {
+   public:
+    /**
+     * Creates a queue over the work of the first pass for the given number of
+     * threads. Every pass takes batch samples per pixel up to limit samples.
+     * The budget limits the samples of all pixels together and is only
+     * enforced by a strict queue.
+     */
+    Queue(std::vector<Work> work, int threads, int batch = 1,
+          int64_t budget = std::numeric_limits<int64_t>::max(),
+          int limit = std::numeric_limits<int>::max(), bool strict = false);
+
+    /**
+     * Takes the next unit of work for the thread. Waits while other threads
+     * still hold work that may be requeued. Returns nullptr once all work is
+     * finished or the queue is stopped.
+     */
+    Work* poll(int thread);
+
+    /**
+     * Requeues work taken by the thread for another sample pass.
+     */
+    void push(int thread, Work* work);
+
+    /**
+     * Marks work taken by a thread as finished.
+     */
+    void finish();
+
+    /**
+     * Stops handing out work. Work already taken may still be pushed or
+     * finished, after which every tile of a strict queue has either the
+     * samples of the current pass or those of the next.
+     */
+    void stop();
+
+    /**
+     * Returns whether the budget covers the current pass of work taken by a
+     * thread. The budget is granted to the work of each pass in order before
+     * the pass starts, so which tiles get the last of it does not depend on
+     * the timing of the threads. A queue which is not strict grants all work.
+     */
+    bool granted(const Work* work) const;
+
+    /**
+     * Returns the number of samples per pixel before the pass that is
+     * currently being rendered.
+     */
+    int samples() const;
+
    private:
-    std::priority_queue<Work, std::vector<Work>, std::greater<Work>> queue;
+    std::vector<Work> work;
 
-    std::mutex mutex;
+    /**
+     * Deques of each thread for even and odd sample passes.
+     */
+    std::vector<std::unique_ptr<Deque>> deques;
+
+    int threads;
+
+    int batch;
+
+    int limit;
+
+    bool strict;
+
+    std::atomic<int> pass;
+
+    /**
+     * The last pass whose budget was granted.
+     */
+    std::atomic<int> allocated;
 
-   public:
     /**
-     * Pushes a unit of work onto the end of the queue.
+     * The number of units of work of even and odd passes which are queued, or
+     * in a strict queue queued or being rendered.
      */
-    void push(const Work& work);
+    std::atomic<int> unfinished[2];
+
+    /**
+     * The number of units of work which are not finished.
+     */
+    std::atomic<int> pending;
+
+    std::atomic<bool> stopped;
 
     /**
-     * Moves and pops the first element of the queue into work. Returns true
-     * on success and false if the queue was empty.
+     * The number of samples that may still be taken across all pixels.
      */
-    bool poll(Work& work);
+    int64_t budget;
 
     /**
-     * Copies the first element of the queue into work. Returns true on success
-     * and false if the queue was empty.
+     * The pass each unit of work is queued for and whether the budget covers
+     * it.
      */
-    bool peek(Work& work);
+    std::vector<int> passes;
+
+    std::vector<uint8_t> grants;
+
+    /**
+     * Grants the budget to the work queued for the pass in work order while
+     * no thread holds any work.
+     */
+    void allocate(int pass);
+
+    Deque& deque(int thread, int parity);
   };
 
   /**
-   * Create a worker that will consume the queue and update the image.
+   * Create a worker that will consume the queue as the given thread and add
+   * samples to the film.
    */
-  Worker(Config config, const Scene& scene, Image& image, Queue& queue,
-         std::atomic<int>& running);
+  Worker(Config config, const Scene& scene, Film& film, Queue& queue,
+         int thread, std::atomic<int>& running);
 
   /**
    * Runs the worker until the queue is empty.
@@ -71,11 +189,30 @@ class Worker {
 
   const Scene& scene;
 
-  Image& image;
+  Film& film;
 
   Queue& queue;
 
+  int thread;
+
   std::atomic<int>& running;
+
+  /**
+   * Checks if every pixel of the work has enough samples and an error below
+   * the adaptive threshold.
+   */
+  bool converged(const Work& work) const;
+
+  /**
+   * Returns the index of the grid cell along a Morton curve.
+   */
+  static uint32_t morton(uint32_t x, uint32_t y);
+
+  /**
+   * Returns the index of the grid cell along a Hilbert curve filling a grid
+   * of side n which must be a power of two.
+   */
+  static uint32_t hilbert(uint32_t n, uint32_t x, uint32_t y);
 };
 
 #endif  // WORKER_HPP_
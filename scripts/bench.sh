@@ -0,0 +1,45 @@
+#!/bin/bash
+
+if [ ! -f ./build/rng_bench ] || [ ! -f ./build/sampler_bench ] ||
+   [ ! -f ./build/sort_bench ]; then
+    ./scripts/cmake.sh
+    make -C ./build -j4
+fi
+
+for scene in Original Glossy Sphere Water; do
+    config=$(echo "$scene" | tr '[:upper:]' '[:lower:]')
+    echo "CornellBox-$scene"
+    ./build/bvh_bench \
+        ./scenes/CornellBox-$scene.obj \
+        ./scenes \
+        ./config/cornell-box-$config.json
+    ./build/render_bench \
+        ./scenes/CornellBox-$scene.obj \
+        ./scenes \
+        ./config/cornell-box-$config.json
+done
+
+./build/rng_bench
+for scene in Original Glossy; do
+    config=$(echo "$scene" | tr '[:upper:]' '[:lower:]')
+    echo "CornellBox-$scene"
+    ./build/sampler_bench \
+        ./scenes/CornellBox-$scene.obj \
+        ./scenes \
+        ./config/cornell-box-$config.json
+done
+
+# Ray sorting only pays off once the scene no longer fits in the caches.
+if [ -f ./.cache/rungholt/rungholt.obj ]; then
+    echo "Rungholt"
+    ./build/sort_bench \
+        ./.cache/rungholt/rungholt.obj \
+        ./.cache/rungholt \
+        ./config/rungholt.json
+else
+    echo "Rungholt was not downloaded, see scripts/download.sh"
+    ./build/sort_bench \
+        ./scenes/CornellBox-Original.obj \
+        ./scenes \
+        ./config/cornell-box-original.json
+fi
@@ -1,43 +1,44 @@
 #include "area-light.hpp"
-#include <algorithm>
+#include <utility>
 #include "samplers.hpp"
 
-AreaLight::AreaLight(std::shared_ptr<Triangle> T) : T(T) {}
+AreaLight::AreaLight(std::shared_ptr<const Mesh> mesh, uint32_t id)
+    : mesh(std::move(mesh)), id(id) {}
 
-Light::Sample AreaLight::sample(const glm::vec3& P, Light::RNG& rng) const {
-  glm::vec3 A = T->vert(T->a.v);
-  glm::vec3 B = T->vert(T->b.v);
-  glm::vec3 C = T->vert(T->c.v);
+Light::Sample AreaLight::sample(const glm::vec3& P,
+                                 Sampler& sampler) const {
+  glm::vec3 A = mesh->vert(id, 0);
+  glm::vec3 B = mesh->vert(id, 1);
+  glm::vec3 C = mesh->vert(id, 2);
 
-  glm::vec3 X = samplers::triangle(A, B, C, rng);
+  glm::vec3 X = samplers::triangle(A, B, C, sampler);
 
-  glm::vec3 N = glm::normalize(glm::cross(A - B, A - C));
-  glm::vec3 D = glm::normalize(P - X);
-
-  if (glm::dot(N, D) < 0) {
-    N = -N;
-  }
-
-  float r = glm::distance(P, X);
-  float cos = glm::dot(D, N);
+  return Sample{X, mesh->material(id).Ke, pdf(*mesh, id, P, X)};
+}
 
-#ifndef NDEBUG
-  assert(cos >= 0);
-#endif
+float AreaLight::pdf(const Mesh& mesh, uint32_t id, const glm::vec3& P,
+                     const glm::vec3& X) {
+  glm::vec3 A = mesh.vert(id, 0);
+  glm::vec3 B = mesh.vert(id, 1);
+  glm::vec3 C = mesh.vert(id, 2);
 
-  glm::vec3 AB = A - B;
-  glm::vec3 AC = A - C;
-  float area = glm::dot(AB, AC) * glm::length(AB) * glm::length(AC);
+  glm::vec3 N = glm::cross(B - A, C - A);
+  float area = 0.5f * glm::length(N);
 
-  Color Ke = T->material().Ke;
-  Color I = Ke * ((cos * area) / (r * r));
+  glm::vec3 D = P - X;
+  float r2 = glm::dot(D, D);
+  float cos = glm::abs(glm::dot(N, D)) / (2 * area * glm::sqrt(r2));
 
-  // Hack - Ensure the color doesn't blow up because this causes very rare but
-  // random artifacts if we are unfortunate enough to sample a point VERY close
-  // to an area light.
-  if (I.max() > Ke.max()) {
-    I = I * (Ke.max() / I.max());
+  if (!(area > 0) || !(cos > 0)) {
+    return 0;
   }
 
-  return Sample{X, I};
+  // The uniform density 1 / area over the triangle projected onto the
+  // directions seen from P.
+  return r2 / (cos * area);
+}
+
+std::unique_ptr<Light> AreaLight::replicate(
+    std::shared_ptr<const Mesh> mesh) const {
+  return std::unique_ptr<Light>(new AreaLight(std::move(mesh), id));
 }
@@ -30,51 +30,31 @@ glm::vec3 BoundingBox::center() const {
   return glm::vec3(mx, my, mz);
 }
 
+float BoundingBox::surface_area() const {
+  glm::vec3 d = max - min;
+  return 2.0f * (d.x * d.y + d.x * d.z + d.y * d.z);
+}
+
 /**
- * Based on:
- * https://www.scratchapixel.com/lessons/3d-basic-rendering/minimal-ray-tracer-rendering-simple-shapes/ray-box-intersection
+ * Slab test based on:
+ * https://tavianator.com/fast-branchless-raybounding-box-intersections/
  */
-bool BoundingBox::intersects(const Ray& ray) const {
-  // Calculate inverse direction once to avoid expensive division.
-  float dxinv = 1.0f / ray.D.x;
-  float dyinv = 1.0f / ray.D.y;
-  float dzinv = 1.0f / ray.D.z;
-
-  // Calculate intersection parametrics of x and y planes
-  float txmin = (min.x - ray.O.x) * dxinv;
-  float txmax = (max.x - ray.O.x) * dxinv;
-
-  float tymin = (min.y - ray.O.y) * dyinv;
-  float tymax = (max.y - ray.O.y) * dyinv;
+BoundingBox::Intersection BoundingBox::intersects(const Ray& ray,
+                                                  float tmax) const {
+  // Calculate intersection parametrics of each pair of planes.
+  glm::vec3 t0 = (min - ray.O) * ray.invD;
+  glm::vec3 t1 = (max - ray.O) * ray.invD;
 
   // Handle negative directions when ray origin inside bounding box.
-  if (txmin > txmax) {
-    std::swap(txmin, txmax);
-  }
-
-  if (tymin > tymax) {
-    std::swap(tymin, tymax);
-  }
+  glm::vec3 tnear = glm::min(t0, t1);
+  glm::vec3 tfar = glm::max(t0, t1);
 
-  if (txmin > tymax || tymin > txmax) {
-    return false;
-  }
+  float entry = std::max(std::max(tnear.x, tnear.y), std::max(tnear.z, 0.0f));
+  float exit = std::min(std::min(tfar.x, tfar.y), std::min(tfar.z, tmax));
 
-  float tmin = std::min(txmin, tymin);
-  float tmax = std::min(txmax, tymax);
-
-  // Continue with similar check for z-axis.
-  float tzmin = (min.z - ray.O.z) * dzinv;
-  float tzmax = (max.z - ray.O.z) * dzinv;
-
-  // Handle negative directions when ray origin inside bounding box (again).
-  if (tzmin > tzmax) {
-    std::swap(tzmin, tzmax);
-  }
-
-  if (tzmin > tmax || tmin > txmax) {
-    return false;
-  }
+  return Intersection{entry, exit};
+}
 
-  return true;
+BoundingBox::Intersection::operator bool() const {
+  return tmin <= tmax;
 }
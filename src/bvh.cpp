@@ -1,6 +1,11 @@
 #include "bvh.hpp"
 #include <algorithm>
 #include <cassert>
+#include <chrono>
+#include <cmath>
+#include <future>
+#include <limits>
+#include "simd.hpp"
 
 std::shared_ptr<spdlog::logger> BVH::LOG = spdlog::stdout_color_mt("BVH");
 
@@ -10,147 +15,1195 @@ std::shared_ptr<spdlog::logger> BVH::LOG = spdlog::stdout_color_mt("BVH");
  * ============================================================
  */
 
-BVH::BVH() : root(BoundingBox()) {}
+BVH::BVH() {}
 
-BVH::BVH(Node&& root, std::vector<Primitive::SharedPtr>&& primitives)
-    : root(std::move(root)), primitives(std::move(primitives)) {}
+BVH::BVH(std::vector<Node>&& nodes, std::shared_ptr<const Mesh> mesh,
+         std::vector<uint32_t>&& triangles)
+    : bounds(nodes.empty() ? BoundingBox() : nodes[0].bounds),
+      nodes(std::move(nodes)),
+      mesh(std::move(mesh)),
+      triangles(std::move(triangles)) {}
 
 BVH::Intersection BVH::intersect(const Ray& ray) const {
-  return intersect(ray, &root);
+  Triangle::Shear shear(ray);
+
+  Hit hit;
+  hit.t = std::numeric_limits<float>::infinity();
+
+  switch (width) {
+    case 4:
+      intersect(ray, shear, nodes4, hit);
+      break;
+    case 8:
+      intersect(ray, shear, nodes8, hit);
+      break;
+    default:
+      intersect(ray, shear, nodes, hit);
+  }
+
+  return resolve(ray, hit);
 }
 
-BVH::Intersection BVH::intersect(const Ray& ray, Node const* node) const {
-  if (node == nullptr || !node->bounds.intersects(ray)) {
-    return Intersection();
-  } else if (!node->primitives.empty()) {
-    // Test primitives!
-    Intersection closest;
+void BVH::intersect_packet(const Ray* rays, int count,
+                           Intersection* intersections) const {
+  assert(count <= PACKET_SIZE);
 
-    for (const auto primitive : node->primitives) {
-      auto inter = primitive->intersects(ray);
-      if (inter && (!closest || inter.t < closest.t)) {
-        closest.t = inter.t;
-        closest.N = inter.N;
-        closest.uv = inter.uv;
-        closest.primitive = primitive;
-      }
+  Packet packet;
+  packet.rays = rays;
+  packet.count = count;
+
+  // Interval arithmetic needs the signs of the directions to agree along
+  // every axis and finite inverse directions.
+  bool coherent = count > 1;
+  for (int axis = 0; axis < 3 && coherent; axis++) {
+    packet.negative[axis] = rays[0].invD[axis] < 0;
+    for (int i = 0; i < count && coherent; i++) {
+      coherent = (rays[i].invD[axis] < 0) == packet.negative[axis] &&
+                 std::isfinite(rays[i].invD[axis]);
     }
+  }
+
+  if (!coherent) {
+    for (int i = 0; i < count; i++) {
+      intersections[i] = intersect(rays[i]);
+    }
+    return;
+  }
+
+  packet.Omin = packet.Omax = rays[0].O;
+  packet.invDmin = packet.invDmax = rays[0].invD;
+  for (int i = 0; i < count; i++) {
+    packet.Omin = glm::min(packet.Omin, rays[i].O);
+    packet.Omax = glm::max(packet.Omax, rays[i].O);
+    packet.invDmin = glm::min(packet.invDmin, rays[i].invD);
+    packet.invDmax = glm::max(packet.invDmax, rays[i].invD);
 
-    return closest;
+    packet.shears[i] = Triangle::Shear(rays[i]);
+    packet.hits[i].t = std::numeric_limits<float>::infinity();
   }
 
-  // Choose the closest intersection.
+  switch (width) {
+    case 4:
+      intersect(packet, nodes4);
+      break;
+    case 8:
+      intersect(packet, nodes8);
+      break;
+    default:
+      intersect(packet, nodes);
+  }
+
+  for (int i = 0; i < count; i++) {
+    intersections[i] = resolve(rays[i], packet.hits[i]);
+  }
+}
+
+BVH::Intersection BVH::resolve(const Ray& ray, const Hit& hit) const {
   Intersection closest;
-  auto left = intersect(ray, node->left.get());
-  auto right = intersect(ray, node->right.get());
 
-  if (left && right) {
-    closest = (left.t < right.t) ? left : right;
-  } else if (!left) {
-    closest = right;
-  } else if (!right) {
-    closest = left;
+  // Interpolate the shading attributes of the closest hit only.
+  if (hit.t < std::numeric_limits<float>::infinity()) {
+    uint32_t id = triangles[hit.index];
+    static_cast<Mesh::Intersection&>(closest) =
+        mesh->interpolate(id, ray, hit.t, hit.u, hit.v);
+    closest.triangle = id;
   }
 
   return closest;
 }
 
+bool BVH::occluded(const Ray& ray, float tmax) const {
+  Triangle::Shear shear(ray);
+
+  switch (width) {
+    case 4:
+      return occluded(ray, shear, tmax, nodes4);
+    case 8:
+      return occluded(ray, shear, tmax, nodes8);
+    default:
+      return occluded(ray, shear, tmax, nodes);
+  }
+}
+
+void BVH::intersect_leaf(const Ray& ray, const Triangle::Shear& shear,
+                         uint32_t begin, uint32_t end, Hit& hit) const {
+  Triangle::Hit candidate;
+
+  for (uint32_t i = begin; i < end; i++) {
+    bool found = watertight
+                     ? records[i].intersect(ray, shear, hit.t, candidate)
+                     : records[i].intersect(ray, hit.t, candidate);
+    if (found) {
+      static_cast<Triangle::Hit&>(hit) = candidate;
+      hit.index = i;
+    }
+  }
+}
+
+bool BVH::occluded_leaf(const Ray& ray, const Triangle::Shear& shear,
+                        uint32_t begin, uint32_t end, float tmax) const {
+  Triangle::Hit candidate;
+
+  for (uint32_t i = begin; i < end; i++) {
+    bool found = watertight
+                     ? records[i].intersect(ray, shear, tmax, candidate)
+                     : records[i].intersect(ray, tmax, candidate);
+    if (found) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+void BVH::intersect(const Ray& ray, const Triangle::Shear& shear,
+                    const std::vector<Node>& nodes, Hit& hit) const {
+  if (nodes.empty()) {
+    return;
+  }
+
+  // Nodes still to visit along with the distance at which the ray enters them.
+  struct Entry {
+    uint32_t index;
+
+    float tmin;
+  };
+
+  Entry stack[STACK_SIZE];
+  int size = 0;
+
+  if (nodes[0].bounds.intersects(ray, hit.t)) {
+    stack[size++] = Entry{0, 0};
+  }
+
+  while (size > 0) {
+    Entry entry = stack[--size];
+
+    // Skip nodes that are farther away than the closest hit so far.
+    if (entry.tmin > hit.t) {
+      continue;
+    }
+
+    const Node& node = nodes[entry.index];
+
+    if (node.count > 0) {
+      // Test triangles!
+      intersect_leaf(ray, shear, node.offset, node.offset + node.count, hit);
+      continue;
+    }
+
+    Entry left{entry.index + 1, 0};
+    Entry right{node.offset, 0};
+
+    auto hl = nodes[left.index].bounds.intersects(ray, hit.t);
+    auto hr = nodes[right.index].bounds.intersects(ray, hit.t);
+    left.tmin = hl.tmin;
+    right.tmin = hr.tmin;
+
+    // Push the farther child first so the nearer child is visited next.
+    if (hl && hr) {
+      assert(size + 2 <= STACK_SIZE);
+      if (left.tmin < right.tmin) {
+        stack[size++] = right;
+        stack[size++] = left;
+      } else {
+        stack[size++] = left;
+        stack[size++] = right;
+      }
+    } else if (hl) {
+      stack[size++] = left;
+    } else if (hr) {
+      stack[size++] = right;
+    }
+  }
+}
+
+bool BVH::occluded(const Ray& ray, const Triangle::Shear& shear, float tmax,
+                   const std::vector<Node>& nodes) const {
+  if (nodes.empty() || !nodes[0].bounds.intersects(ray, tmax)) {
+    return false;
+  }
+
+  uint32_t stack[STACK_SIZE];
+  int size = 0;
+  stack[size++] = 0;
+
+  while (size > 0) {
+    const Node& node = nodes[stack[--size]];
+
+    if (node.count > 0) {
+      if (occluded_leaf(ray, shear, node.offset, node.offset + node.count,
+                        tmax)) {
+        return true;
+      }
+      continue;
+    }
+
+    uint32_t left = &node - nodes.data() + 1;
+    uint32_t right = node.offset;
+
+    // Any hit will do so there is no need to order the children.
+    if (nodes[right].bounds.intersects(ray, tmax)) {
+      stack[size++] = right;
+    }
+
+    if (nodes[left].bounds.intersects(ray, tmax)) {
+      assert(size < STACK_SIZE);
+      stack[size++] = left;
+    }
+  }
+
+  return false;
+}
+
+template <int W>
+void BVH::intersect(const Ray& ray, const Triangle::Shear& shear,
+                    const std::vector<WideNode<W>>& wide, Hit& hit) const {
+  if (wide.empty() || !bounds.intersects(ray, hit.t)) {
+    return;
+  }
+
+  // Children still to visit along with the distance at which the ray enters
+  // them. Leaf children are pushed directly to avoid a node lookup.
+  struct Entry {
+    uint32_t child;
+
+    uint32_t count;
+
+    float tmin;
+  };
+
+  Entry stack[W * STACK_SIZE];
+  int size = 0;
+  stack[size++] = Entry{0, 0, 0};
+
+  while (size > 0) {
+    Entry entry = stack[--size];
+
+    // Skip nodes that are farther away than the closest hit so far.
+    if (entry.tmin > hit.t) {
+      continue;
+    }
+
+    if (entry.count > 0) {
+      // Test triangles!
+      intersect_leaf(ray, shear, entry.child, entry.child + entry.count, hit);
+      continue;
+    }
+
+    const WideNode<W>& node = wide[entry.child];
+
+    float tnear[W];
+    int mask = simd::slabs<W>(node.bounds, ray.O, ray.invD, hit.t, tnear);
+    mask &= (1 << node.size) - 1;
+
+    // Push hit children farthest first so the nearest is visited next.
+    int first = size;
+    for (int i = 0; mask != 0; i++, mask >>= 1) {
+      if ((mask & 1) == 0) {
+        continue;
+      }
+
+      Entry child{node.child[i], node.count[i], tnear[i]};
+
+      int j = size++;
+      for (; j > first && stack[j - 1].tmin < child.tmin; j--) {
+        stack[j] = stack[j - 1];
+      }
+      stack[j] = child;
+    }
+
+    assert(size <= W * STACK_SIZE);
+  }
+}
+
+template <int W>
+bool BVH::occluded(const Ray& ray, const Triangle::Shear& shear, float tmax,
+                   const std::vector<WideNode<W>>& wide) const {
+  if (wide.empty() || !bounds.intersects(ray, tmax)) {
+    return false;
+  }
+
+  uint32_t stack[W * STACK_SIZE];
+  int size = 0;
+  stack[size++] = 0;
+
+  while (size > 0) {
+    const WideNode<W>& node = wide[stack[--size]];
+
+    float tnear[W];
+    int mask = simd::slabs<W>(node.bounds, ray.O, ray.invD, tmax, tnear);
+    mask &= (1 << node.size) - 1;
+
+    // Any hit will do so leaves are tested as soon as they are found.
+    for (int i = 0; mask != 0; i++, mask >>= 1) {
+      if ((mask & 1) == 0) {
+        continue;
+      } else if (node.count[i] == 0) {
+        stack[size++] = node.child[i];
+        continue;
+      }
+
+      if (occluded_leaf(ray, shear, node.child[i],
+                        node.child[i] + node.count[i], tmax)) {
+        return true;
+      }
+    }
+
+    assert(size <= W * STACK_SIZE);
+  }
+
+  return false;
+}
+
+float BVH::Packet::tmax() const {
+  float t = hits[0].t;
+  for (int i = 1; i < count; i++) {
+    t = std::max(t, hits[i].t);
+  }
+  return t;
+}
+
+float BVH::Packet::enters(const glm::vec3& min, const glm::vec3& max,
+                          float tmax) const {
+  // Multiplies the [a0, a1] and [b0, b1] intervals and returns the bound
+  // selected by f.
+  auto multiply = [](float a0, float a1, float b0, float b1, auto f) {
+    return f(f(a0 * b0, a0 * b1), f(a1 * b0, a1 * b1));
+  };
+  auto lower = [](float a, float b) { return std::min(a, b); };
+  auto upper = [](float a, float b) { return std::max(a, b); };
+
+  float entry = 0;
+  float exit = tmax;
+
+  for (int axis = 0; axis < 3; axis++) {
+    // Every ray enters through the same slab plane since the signs agree.
+    float near = negative[axis] ? max[axis] : min[axis];
+    float far = negative[axis] ? min[axis] : max[axis];
+
+    entry = std::max(entry, multiply(near - Omax[axis], near - Omin[axis],
+                                     invDmin[axis], invDmax[axis], lower));
+    exit = std::min(exit, multiply(far - Omax[axis], far - Omin[axis],
+                                   invDmin[axis], invDmax[axis], upper));
+  }
+
+  return entry <= exit ? entry : std::numeric_limits<float>::infinity();
+}
+
+void BVH::intersect_leaf(Packet& packet, uint32_t begin, uint32_t end) const {
+  for (int i = 0; i < packet.count; i++) {
+    intersect_leaf(packet.rays[i], packet.shears[i], begin, end,
+                   packet.hits[i]);
+  }
+}
+
+void BVH::intersect(Packet& packet, const std::vector<Node>& nodes) const {
+  if (nodes.empty()) {
+    return;
+  }
+
+  struct Entry {
+    uint32_t index;
+
+    float tmin;
+  };
+
+  const float INF = std::numeric_limits<float>::infinity();
+
+  Entry stack[STACK_SIZE];
+  int size = 0;
+
+  float tmin = packet.enters(nodes[0].bounds.min, nodes[0].bounds.max, INF);
+  if (tmin < INF) {
+    stack[size++] = Entry{0, tmin};
+  }
+
+  while (size > 0) {
+    Entry entry = stack[--size];
+
+    // Skip nodes that are farther away than every closest hit so far.
+    float tmax = packet.tmax();
+    if (entry.tmin > tmax) {
+      continue;
+    }
+
+    const Node& node = nodes[entry.index];
+
+    if (node.count > 0) {
+      intersect_leaf(packet, node.offset, node.offset + node.count);
+      continue;
+    }
+
+    const BoundingBox& lb = nodes[entry.index + 1].bounds;
+    const BoundingBox& rb = nodes[node.offset].bounds;
+    Entry left{entry.index + 1, packet.enters(lb.min, lb.max, tmax)};
+    Entry right{node.offset, packet.enters(rb.min, rb.max, tmax)};
+
+    // Push the farther child first so the nearer child is visited next.
+    if (left.tmin < INF && right.tmin < INF) {
+      assert(size + 2 <= STACK_SIZE);
+      if (left.tmin < right.tmin) {
+        stack[size++] = right;
+        stack[size++] = left;
+      } else {
+        stack[size++] = left;
+        stack[size++] = right;
+      }
+    } else if (left.tmin < INF) {
+      stack[size++] = left;
+    } else if (right.tmin < INF) {
+      stack[size++] = right;
+    }
+  }
+}
+
+template <int W>
+void BVH::intersect(Packet& packet,
+                    const std::vector<WideNode<W>>& wide) const {
+  const float INF = std::numeric_limits<float>::infinity();
+  if (wide.empty() || packet.enters(bounds.min, bounds.max, INF) == INF) {
+    return;
+  }
+
+  struct Entry {
+    uint32_t child;
+
+    uint32_t count;
+
+    float tmin;
+  };
+
+  Entry stack[W * STACK_SIZE];
+  int size = 0;
+  stack[size++] = Entry{0, 0, 0};
+
+  while (size > 0) {
+    Entry entry = stack[--size];
+
+    // Skip nodes that are farther away than every closest hit so far.
+    float tmax = packet.tmax();
+    if (entry.tmin > tmax) {
+      continue;
+    }
+
+    if (entry.count > 0) {
+      intersect_leaf(packet, entry.child, entry.child + entry.count);
+      continue;
+    }
+
+    const WideNode<W>& node = wide[entry.child];
+
+    // Push hit children farthest first so the nearest is visited next.
+    int first = size;
+    for (uint32_t i = 0; i < node.size; i++) {
+      glm::vec3 min(node.bounds[0][i], node.bounds[1][i], node.bounds[2][i]);
+      glm::vec3 max(node.bounds[3][i], node.bounds[4][i], node.bounds[5][i]);
+      float tmin = packet.enters(min, max, tmax);
+      if (tmin == INF) {
+        continue;
+      }
+
+      Entry child{node.child[i], node.count[i], tmin};
+
+      int j = size++;
+      for (; j > first && stack[j - 1].tmin < child.tmin; j--) {
+        stack[j] = stack[j - 1];
+      }
+      stack[j] = child;
+    }
+
+    assert(size <= W * STACK_SIZE);
+  }
+}
+
 BoundingBox BVH::get_bounds() const {
-  return root.bounds;
+  return bounds;
+}
+
+const Mesh& BVH::get_mesh() const {
+  assert(mesh);
+  return *mesh;
+}
+
+void BVH::write(cache::Writer& writer) const {
+  writer.write(width);
+  writer.write(bounds);
+  writer.write(nodes);
+  writer.write(nodes4);
+  writer.write(nodes8);
+  writer.write(triangles);
+}
+
+BVH BVH::read(cache::Reader& reader, std::shared_ptr<const Mesh> mesh,
+              const Config& config) {
+  BVH bvh;
+  bvh.width = reader.read<int>();
+  bvh.bounds = reader.read<BoundingBox>();
+  reader.read(bvh.nodes);
+  reader.read(bvh.nodes4);
+  reader.read(bvh.nodes8);
+  reader.read(bvh.triangles);
+  bvh.mesh = std::move(mesh);
+  bvh.prepare(config);
+  return bvh;
+}
+
+BVH BVH::replicate(std::shared_ptr<const Mesh> mesh) const {
+  BVH bvh(*this);
+  bvh.mesh = std::move(mesh);
+  return bvh;
 }
 
-BVH BVH::build(std::vector<Primitive::SharedPtr>&& primitives) {
-  // Create the node before std::move(primitive)!
-  std::vector<Primitive*> naked(primitives.size());
-  for (size_t i = 0; i < primitives.size(); i++) {
-    naked[i] = primitives[i].get();
+BVH BVH::build(std::shared_ptr<const Mesh> mesh, const Config& config) {
+  if (mesh->size() == 0) {
+    return BVH();
+  }
+
+  auto start = std::chrono::steady_clock::now();
+
+  // Cache the bounds so the builder does not repeatedly query the mesh.
+  std::vector<Reference> references(mesh->size());
+  for (uint32_t i = 0; i < mesh->size(); i++) {
+    BoundingBox bounds = mesh->bounds(i);
+    references[i] = Reference{bounds, bounds.center(), i};
+  }
+
+  int threads = std::max(1, config.job.threads);
+
+  std::vector<Node> nodes;
+  nodes.reserve(2 * references.size());
+  if (config.bvh.builder == "lbvh") {
+    build_lbvh(nodes, references, threads, config.bvh);
+  } else {
+    build(nodes, references.begin(), references.end(), 0,
+          config.bvh.max_depth, threads, config.bvh);
+  }
+  nodes.shrink_to_fit();
+
+  // Store triangle ids in the order of the leaves referencing them.
+  std::vector<uint32_t> triangles(references.size());
+  for (size_t i = 0; i < references.size(); i++) {
+    triangles[i] = references[i].index;
+  }
+
+  auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+      std::chrono::steady_clock::now() - start);
+
+  LOG->info("Built {:s} BVH over {:d} triangles in {:d} ms with {:d} threads.",
+            config.bvh.builder, triangles.size(), elapsed.count(),
+            config.job.threads);
+  LOG->info("SAH cost: {:.2f} with {:d} nodes.", sah_cost(nodes),
+            nodes.size());
+
+  BVH bvh(std::move(nodes), std::move(mesh), std::move(triangles));
+  bvh.prepare(config);
+
+  if (config.bvh.width == 4) {
+    bvh.collapse(bvh.nodes4);
+  } else if (config.bvh.width == 8) {
+    bvh.collapse(bvh.nodes8);
+  }
+
+  return bvh;
+}
+
+void BVH::prepare(const Config& config) {
+  watertight = config.bvh.watertight;
+  records.resize(triangles.size());
+
+  for (size_t i = 0; i < triangles.size(); i++) {
+    const glm::vec3& a = mesh->vert(triangles[i], 0);
+    const glm::vec3& b = mesh->vert(triangles[i], 1);
+    const glm::vec3& c = mesh->vert(triangles[i], 2);
+    records[i] = watertight ? Triangle::vertices(a, b, c)
+                            : Triangle::edges(a, b, c);
+  }
+}
+
+template <int W>
+void BVH::collapse(std::vector<WideNode<W>>& wide) {
+  wide.clear();
+  wide.reserve(nodes.size() / (W - 1) + 1);
+  collapse(wide, 0);
+  wide.shrink_to_fit();
+
+  LOG->info("Collapsed {:d} binary nodes into {:d} {:d}-wide nodes.",
+            nodes.size(), wide.size(), W);
+
+  // The binary nodes are no longer needed for traversal.
+  nodes.clear();
+  nodes.shrink_to_fit();
+  width = W;
+}
+
+template <int W>
+uint32_t BVH::collapse(std::vector<WideNode<W>>& wide, uint32_t index) const {
+  uint32_t children[W] = {index};
+  int size = 1;
+
+  // Open the largest interior descendant until all child slots are used.
+  while (size < W) {
+    int best = -1;
+    float area = -1;
+
+    for (int i = 0; i < size; i++) {
+      const Node& node = nodes[children[i]];
+      if (node.count == 0 && node.bounds.surface_area() > area) {
+        best = i;
+        area = node.bounds.surface_area();
+      }
+    }
+
+    if (best == -1) {
+      break;
+    }
+
+    uint32_t opened = children[best];
+    children[best] = opened + 1;
+    children[size++] = nodes[opened].offset;
+  }
+
+  uint32_t w = wide.size();
+  wide.emplace_back();
+  wide[w].size = size;
+
+  for (int i = 0; i < W; i++) {
+    // Unused slots get an empty box at the origin and are masked out.
+    BoundingBox box = i < size ? nodes[children[i]].bounds : BoundingBox();
+    wide[w].bounds[0][i] = box.min.x;
+    wide[w].bounds[1][i] = box.min.y;
+    wide[w].bounds[2][i] = box.min.z;
+    wide[w].bounds[3][i] = box.max.x;
+    wide[w].bounds[4][i] = box.max.y;
+    wide[w].bounds[5][i] = box.max.z;
+    wide[w].child[i] = 0;
+    wide[w].count[i] = 0;
+  }
+
+  for (int i = 0; i < size; i++) {
+    const Node& node = nodes[children[i]];
+
+    if (node.count > 0) {
+      wide[w].child[i] = node.offset;
+      wide[w].count[i] = node.count;
+    } else {
+      // Recursion may reallocate the wide nodes so assign after returning.
+      uint32_t child = collapse(wide, children[i]);
+      wide[w].child[i] = child;
+    }
+  }
+
+  return w;
+}
+
+template <typename F>
+void BVH::parallel_chunks(size_t size, int threads, F f) {
+  std::vector<std::future<void>> tasks;
+
+  for (int c = 1; c < threads; c++) {
+    size_t begin = size * c / threads;
+    size_t end = size * (c + 1) / threads;
+    tasks.push_back(std::async(std::launch::async, f, c, begin, end));
+  }
+
+  // Process the first chunk on the calling thread.
+  f(0, 0, size / threads);
+
+  for (auto& task : tasks) {
+    task.get();
+  }
+}
+
+template <typename P>
+BVH::Iterator BVH::partition(Iterator begin, Iterator end, int threads,
+                             P predicate) {
+  size_t size = end - begin;
+
+  if (threads <= 1 || size < PARALLEL_SIZE) {
+    return std::stable_partition(begin, end, predicate);
+  }
+
+  // Count the references going left in each chunk.
+  std::vector<uint8_t> flags(size);
+  std::vector<size_t> lefts(threads);
+
+  parallel_chunks(size, threads, [&](int c, size_t b, size_t e) {
+    size_t count = 0;
+    for (size_t i = b; i < e; i++) {
+      flags[i] = predicate(begin[i]);
+      count += flags[i];
+    }
+    lefts[c] = count;
+  });
+
+  // Scatter each chunk to its range on either side of the split so the result
+  // is the same as a serial stable partition.
+  size_t total = 0;
+  for (size_t count : lefts) {
+    total += count;
+  }
+
+  std::vector<Reference> partitioned(size);
+
+  parallel_chunks(size, threads, [&](int c, size_t b, size_t e) {
+    size_t left = 0;
+    for (int k = 0; k < c; k++) {
+      left += lefts[k];
+    }
+    size_t right = total + b - left;
+
+    for (size_t i = b; i < e; i++) {
+      partitioned[flags[i] ? left++ : right++] = begin[i];
+    }
+  });
+
+  parallel_chunks(size, threads, [&](int /*chunk*/, size_t b, size_t e) {
+    std::copy(partitioned.begin() + b, partitioned.begin() + e, begin + b);
+  });
+
+  return begin + total;
+}
+
+void BVH::measure(Iterator begin, Iterator end, int threads,
+                  BoundingBox& bounds, BoundingBox& centroids) {
+  size_t size = end - begin;
+  int chunks = (size < PARALLEL_SIZE) ? 1 : threads;
+
+  std::vector<BoundingBox> partial(2 * chunks);
+
+  parallel_chunks(size, chunks, [&](int c, size_t b, size_t e) {
+    partial[2 * c] = begin[b].bounds;
+    partial[2 * c + 1] = BoundingBox(begin[b].center);
+    for (size_t i = b; i < e; i++) {
+      partial[2 * c].expand(begin[i].bounds);
+      partial[2 * c + 1].expand(begin[i].center);
+    }
+  });
+
+  bounds = partial[0];
+  centroids = partial[1];
+  for (int c = 1; c < chunks; c++) {
+    bounds.expand(partial[2 * c]);
+    centroids.expand(partial[2 * c + 1]);
   }
-  auto node = build(naked, MAX_HEIGHT);
-  return BVH(std::move(*node), std::move(primitives));
 }
 
 //
 // Based on:
 // https://blog.frogslayer.com/kd-trees-for-faster-ray-tracing-with-triangles/
+void BVH::build(std::vector<Node>& nodes, Iterator begin, Iterator end,
+                uint32_t offset, int height, int threads,
+                const Config::BVH& config) {
+  assert(begin != end);
+
+  // Setup node bounding box.
+  uint32_t index = nodes.size();
+  nodes.emplace_back();
+
+  BoundingBox bounds, centroids;
+  measure(begin, end, threads, bounds, centroids);
+  nodes[index].bounds = bounds;
+
+  size_t size = end - begin;
+
+  if (size <= MAX_LEAF_SIZE &&
+      (height <= 0 || size <= static_cast<size_t>(config.leaf_size))) {
+    // Reference all primitives from the leaf node.
+    nodes[index].offset = offset;
+    nodes[index].count = size;
+    LOG->debug("Created node with {:d} primitives.", size);
+    return;
+  }
+
+  // Leaves cannot address more than MAX_LEAF_SIZE primitives so keep halving
+  // oversized nodes past the maximum height.
+  Iterator split = end;
+  if (height > 0) {
+    split = (config.builder == "sah")
+                ? split_sah(begin, end, centroids, threads, config)
+                : split_midpoint(begin, end, bounds, threads);
+  }
+
+  // If the split did not work just sort by mid-point of widest axis and split
+  // set in half.
+  if (split == begin || split == end) {
+    split = split_median(begin, end, get_split_axis(bounds));
+  }
+
+  // Ensure we aren't adding depth pointlessly...
+  assert(split != begin && split != end);
+
+  uint32_t right_offset = offset + (split - begin);
+
+  fork(nodes, index, size, threads,
+       [&](std::vector<Node>& out, bool right, int threads) {
+         if (right) {
+           build(out, split, end, right_offset, height - 1, threads, config);
+         } else {
+           build(out, begin, split, offset, height - 1, threads, config);
+         }
+       });
+
+  LOG->debug("Created node with {:d} primitives.", size);
+}
+
+template <typename F>
+void BVH::fork(std::vector<Node>& nodes, uint32_t index, size_t size,
+               int threads, F build) {
+  if (threads <= 1 || size < PARALLEL_SIZE) {
+    build(nodes, false, 1);
+    nodes[index].offset = nodes.size();
+    build(nodes, true, 1);
+    return;
+  }
+
+  // Fork the right sub-tree and split the threads between both halves.
+  std::vector<Node> right;
+  auto task = std::async(std::launch::async, [&]() {
+    build(right, true, threads - threads / 2);
+  });
+
+  build(nodes, false, threads / 2);
+  task.get();
+
+  // Interior offsets of the right sub-tree are relative to its own array.
+  uint32_t base = nodes.size();
+  nodes[index].offset = base;
+  for (auto& node : right) {
+    node.offset += (node.count == 0) ? base : 0;
+  }
+  nodes.insert(nodes.end(), right.begin(), right.end());
+}
+
+BVH::Iterator BVH::split_midpoint(Iterator begin, Iterator end,
+                                  const BoundingBox& bounds, int threads) {
+  // Split primitives along widest axis.
+  Axis axis = get_split_axis(bounds);
+  float mid = get(bounds.center(), axis);
+
+  auto predicate = [mid, axis](const Reference& ref) {
+    return get(ref.center, axis) < mid;
+  };
+
+  return partition(begin, end, threads, predicate);
+}
+
+//
+// Binned SAH based on:
+// http://www.sci.utah.edu/~wald/Publications/2007/ParallelBVHBuild/fastbuild.pdf
 //
-BVH::Node::NodePtr BVH::build(std::vector<Primitive*>& primitives, int height) {
-  // Handle case of no primitives.
-  if (primitives.empty()) {
-    return BVH::Node::NodePtr(nullptr);
+BVH::Iterator BVH::split_sah(Iterator begin, Iterator end,
+                             const BoundingBox& centroids, int threads,
+                             const Config::BVH& config) {
+  struct Bin {
+    BoundingBox bounds;
+
+    size_t count = 0;
+
+    void add(const BoundingBox& box, size_t n) {
+      if (count == 0) {
+        bounds = box;
+      } else {
+        bounds.expand(box);
+      }
+      count += n;
+    }
+  };
+
+  size_t size = end - begin;
+  int chunks = (size < PARALLEL_SIZE) ? 1 : threads;
+  int bins = config.bins;
+
+  // Bin primitives by centroid so only bins - 1 planes need to be evaluated.
+  // Each chunk fills its own bins for all axes which are merged afterwards.
+  glm::vec3 lo = centroids.min;
+  glm::vec3 extent = centroids.max - centroids.min;
+  glm::vec3 scale;
+  for (int axis = Axis::X; axis <= Axis::Z; axis++) {
+    scale[axis] = extent[axis] > 0 ? bins / extent[axis] : 0;
   }
 
-  // Setup node bounding box.
-  auto node = BVH::Node::NodePtr(new BVH::Node(primitives[0]->bounds()));
-  for (const auto primitive : primitives) {
-    node->bounds.expand(primitive->bounds());
+  std::vector<Bin> binned(chunks * 3 * bins);
+
+  parallel_chunks(size, chunks, [&](int c, size_t b, size_t e) {
+    Bin* local = &binned[c * 3 * bins];
+    for (size_t i = b; i < e; i++) {
+      const Reference& ref = begin[i];
+      for (int axis = Axis::X; axis <= Axis::Z; axis++) {
+        int k = static_cast<int>((ref.center[axis] - lo[axis]) * scale[axis]);
+        local[axis * bins + std::min(bins - 1, k)].add(ref.bounds, 1);
+      }
+    }
+  });
+
+  for (int c = 1; c < chunks; c++) {
+    for (int k = 0; k < 3 * bins; k++) {
+      const Bin& bin = binned[c * 3 * bins + k];
+      if (bin.count > 0) {
+        binned[k].add(bin.bounds, bin.count);
+      }
+    }
   }
 
-  if (height == 0 || primitives.size() < MIN_SIZE) {
-    // Dump all primitives into leaf node.
-    for (const auto primitive : primitives) {
-      node->primitives.push_back(primitive);
+  float best_cost = std::numeric_limits<float>::infinity();
+  int best_axis = -1;
+  int best_bin = 0;
+
+  std::vector<float> right_area(bins);
+  std::vector<size_t> right_count(bins);
+
+  for (int axis = Axis::X; axis <= Axis::Z; axis++) {
+    // All centroids are on the same plane along this axis.
+    if (extent[axis] <= 0) {
+      continue;
+    }
+
+    const Bin* axis_bins = &binned[axis * bins];
+
+    // Sweep from the right to find the area and count right of each plane.
+    Bin acc;
+    for (int b = bins - 1; b > 0; b--) {
+      if (axis_bins[b].count > 0) {
+        acc.add(axis_bins[b].bounds, axis_bins[b].count);
+      }
+      right_area[b] = acc.count > 0 ? acc.bounds.surface_area() : 0;
+      right_count[b] = acc.count;
+    }
+
+    // Sweep from the left evaluating the plane between bins b - 1 and b.
+    acc = Bin();
+    for (int b = 1; b < bins; b++) {
+      if (axis_bins[b - 1].count > 0) {
+        acc.add(axis_bins[b - 1].bounds, axis_bins[b - 1].count);
+      }
+
+      if (acc.count == 0 || right_count[b] == 0) {
+        continue;
+      }
+
+      float cost = acc.bounds.surface_area() * acc.count +
+                   right_area[b] * right_count[b];
+      if (cost < best_cost) {
+        best_cost = cost;
+        best_axis = axis;
+        best_bin = b;
+      }
     }
-    node->size = node->primitives.size();
-    LOG->debug("Created node with {:d} primitives.", node->size);
-    return node;
   }
 
-  // Split primitives along widest axis.
-  Axis axis = get_split_axis(node.get());
-  float mid = get(node->bounds.center(), axis);
+  if (best_axis == -1) {
+    return end;
+  }
+
+  float axis_lo = lo[best_axis];
+  float axis_scale = scale[best_axis];
 
-  // Partition.
-  auto predicate = [mid, axis](const Primitive* prim) {
-    return get(prim->bounds().center(), axis) < mid;
+  auto predicate = [=](const Reference& ref) {
+    int b = static_cast<int>((ref.center[best_axis] - axis_lo) * axis_scale);
+    return std::min(bins - 1, b) < best_bin;
   };
 
-  auto split = std::partition(primitives.begin(), primitives.end(), predicate);
+  return partition(begin, end, threads, predicate);
+}
 
-  // If the partition did not work just sort by mid-point of widest
-  // axis and split set in halt.
-  if (split == primitives.begin() || split == primitives.end()) {
-    split = primitives.begin() + primitives.size() / 2;
+//
+// Linear BVH based on:
+// http://luebke.us/publications/eg09.pdf
+// http://www.pbr-book.org/3ed-2018/Primitives_and_Intersection_Acceleration/Bounding_Volume_Hierarchies.html#LinearBoundingVolumeHierarchies
+//
+void BVH::build_lbvh(std::vector<Node>& nodes,
+                     std::vector<Reference>& references, int threads,
+                     const Config::BVH& config) {
+  size_t size = references.size();
+  int chunks = (size < PARALLEL_SIZE) ? 1 : threads;
 
-    auto comparator = [axis](Primitive* lhs, Primitive* rhs) {
-      return get(lhs->bounds().center(), axis) <
-             get(rhs->bounds().center(), axis);
-    };
+  BoundingBox bounds, centroids;
+  measure(references.begin(), references.end(), threads, bounds, centroids);
 
-    std::sort(primitives.begin(), primitives.end(), comparator);
+  // Quantize centroids onto a 1024^3 grid and interleave the coordinates.
+  glm::vec3 extent = centroids.max - centroids.min;
+  glm::vec3 scale;
+  for (int axis = Axis::X; axis <= Axis::Z; axis++) {
+    scale[axis] = extent[axis] > 0 ? MORTON_GRID / extent[axis] : 0;
   }
 
-  std::vector<Primitive*> left(primitives.begin(), split);
-  std::vector<Primitive*> right(split, primitives.end());
+  std::vector<Morton> codes(size);
 
-  // Ensure we aren't adding depth pointlessly...
-  assert(!left.empty() && !right.empty());
+  parallel_chunks(size, chunks, [&](int /*chunk*/, size_t b, size_t e) {
+    for (size_t i = b; i < e; i++) {
+      glm::vec3 p = (references[i].center - centroids.min) * scale;
+      codes[i] = Morton{morton(p), static_cast<uint32_t>(i)};
+    }
+  });
+
+  radix_sort(codes, chunks);
+
+  // Reorder the references to match the sorted codes.
+  std::vector<Reference> sorted(size);
+  std::vector<uint32_t> keys(size);
+
+  parallel_chunks(size, chunks, [&](int /*chunk*/, size_t b, size_t e) {
+    for (size_t i = b; i < e; i++) {
+      sorted[i] = references[codes[i].index];
+      keys[i] = codes[i].code;
+    }
+  });
 
-  if (!left.empty()) {
-    node->left = build(left, height - 1);
-    node->size += node->left->size;
+  references = std::move(sorted);
+
+  emit_lbvh(nodes, references.begin(), references.end(), keys.data(), 0,
+            MORTON_BITS - 1, config.max_depth, threads, config);
+}
+
+void BVH::emit_lbvh(std::vector<Node>& nodes, Iterator begin, Iterator end,
+                    const uint32_t* keys, uint32_t offset, int bit,
+                    int height, int threads, const Config::BVH& config) {
+  assert(begin != end);
+
+  uint32_t index = nodes.size();
+  nodes.emplace_back();
+
+  size_t size = end - begin;
+
+  if (size <= MAX_LEAF_SIZE &&
+      (height <= 0 || size <= static_cast<size_t>(config.leaf_size))) {
+    BoundingBox bounds = begin->bounds;
+    for (auto it = begin; it != end; it++) {
+      bounds.expand(it->bounds);
+    }
+    nodes[index].bounds = bounds;
+    nodes[index].offset = offset;
+    nodes[index].count = size;
+    return;
+  }
+
+  // Keys are sorted so the split is at the first key with the highest bit
+  // that differs across the range set.
+  size_t split = size / 2;
+
+  for (; bit >= 0; bit--) {
+    uint32_t mask = 1u << bit;
+    if ((keys[0] & mask) != (keys[size - 1] & mask)) {
+      auto first = std::partition_point(
+          keys, keys + size, [mask](uint32_t key) { return !(key & mask); });
+      split = first - keys;
+      break;
+    }
   }
 
-  if (!right.empty()) {
-    node->right = build(right, height - 1);
-    node->size += node->right->size;
+  // Identical keys are split in half.
+  int next = std::max(bit - 1, -1);
+
+  fork(nodes, index, size, threads,
+       [&](std::vector<Node>& out, bool right, int threads) {
+         if (right) {
+           emit_lbvh(out, begin + split, end, keys + split, offset + split,
+                     next, height - 1, threads, config);
+         } else {
+           emit_lbvh(out, begin, begin + split, keys, offset, next,
+                     height - 1, threads, config);
+         }
+       });
+
+  // Children are complete so the bounds are merged bottom up.
+  BoundingBox bounds = nodes[index + 1].bounds;
+  bounds.expand(nodes[nodes[index].offset].bounds);
+  nodes[index].bounds = bounds;
+}
+
+void BVH::radix_sort(std::vector<Morton>& codes, int threads) {
+  size_t size = codes.size();
+  std::vector<Morton> temp(size);
+  std::vector<size_t> counts(threads * RADIX_BUCKETS);
+
+  for (int shift = 0; shift < MORTON_BITS; shift += RADIX_BITS) {
+    std::fill(counts.begin(), counts.end(), 0);
+
+    parallel_chunks(size, threads, [&](int c, size_t b, size_t e) {
+      size_t* local = &counts[c * RADIX_BUCKETS];
+      for (size_t i = b; i < e; i++) {
+        local[(codes[i].code >> shift) & (RADIX_BUCKETS - 1)]++;
+      }
+    });
+
+    // Each chunk writes each bucket after the same bucket of earlier chunks
+    // which keeps the sort stable.
+    size_t total = 0;
+    for (int k = 0; k < RADIX_BUCKETS; k++) {
+      for (int c = 0; c < threads; c++) {
+        size_t count = counts[c * RADIX_BUCKETS + k];
+        counts[c * RADIX_BUCKETS + k] = total;
+        total += count;
+      }
+    }
+
+    parallel_chunks(size, threads, [&](int c, size_t b, size_t e) {
+      size_t* local = &counts[c * RADIX_BUCKETS];
+      for (size_t i = b; i < e; i++) {
+        temp[local[(codes[i].code >> shift) & (RADIX_BUCKETS - 1)]++] =
+            codes[i];
+      }
+    });
+
+    std::swap(codes, temp);
   }
+}
+
+uint32_t BVH::morton(const glm::vec3& p) {
+  // Spreads the lower 10 bits of v so there are two zeros between each bit.
+  auto expand = [](uint32_t v) {
+    v = (v * 0x00010001u) & 0xFF0000FFu;
+    v = (v * 0x00000101u) & 0x0F00F00Fu;
+    v = (v * 0x00000011u) & 0xC30C30C3u;
+    v = (v * 0x00000005u) & 0x49249249u;
+    return v;
+  };
+
+  auto quantize = [](float f) {
+    return static_cast<uint32_t>(
+        std::min(std::max(f, 0.0f), MORTON_GRID - 1.0f));
+  };
+
+  return (expand(quantize(p.x)) << 2) | (expand(quantize(p.y)) << 1) |
+         expand(quantize(p.z));
+}
+
+BVH::Iterator BVH::split_median(Iterator begin, Iterator end, Axis axis) {
+  auto split = begin + (end - begin) / 2;
+
+  auto comparator = [axis](const Reference& lhs, const Reference& rhs) {
+    return get(lhs.center, axis) < get(rhs.center, axis);
+  };
+
+  std::nth_element(begin, split, end, comparator);
+  return split;
+}
 
-  LOG->debug("Created node with {:d} primitives.", node->size);
+float BVH::sah_cost(const std::vector<Node>& nodes) {
+  float root_area = nodes.empty() ? 0 : nodes[0].bounds.surface_area();
+  float cost = 0;
 
-  return node;
+  for (const auto& node : nodes) {
+    float p = root_area > 0 ? node.bounds.surface_area() / root_area : 1;
+    cost += p * (node.count > 0 ? INTERSECTION_COST * node.count
+                                : TRAVERSAL_COST);
+  }
+
+  return cost;
 }
 
-BVH::Axis BVH::get_split_axis(Node const* node) {
+BVH::Axis BVH::get_split_axis(const BoundingBox& bounds) {
   Axis axis = Axis::X;
-  float widest = node->bounds.max.x - node->bounds.min.x;
+  float widest = bounds.max.x - bounds.min.x;
 
-  float wy = node->bounds.max.y - node->bounds.min.y;
+  float wy = bounds.max.y - bounds.min.y;
   if (wy > widest) {
     axis = Axis::Y;
     widest = wy;
   }
 
-  float wz = node->bounds.max.z - node->bounds.min.z;
+  float wz = bounds.max.z - bounds.min.z;
   if (wz > widest) {
     axis = Axis::Z;
   }
@@ -168,11 +1221,3 @@ float BVH::get(const glm::vec3& v, Axis axis) {
       return v.z;
   }
 }
-
-/**
- * ============================================================
- *                          BVH::Node
- * ============================================================
- */
-
-BVH::Node::Node(const BoundingBox& bounds) : bounds(bounds) {}
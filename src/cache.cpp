@@ -0,0 +1,174 @@
+#include "cache.hpp"
+#include <cstdio>
+#include <cstring>
+#include <iterator>
+#include <random>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define CACHE_MMAP
+#endif
+
+namespace cache {
+uint64_t hash(const void* data, size_t size, uint64_t seed) {
+  const unsigned char* bytes = static_cast<const unsigned char*>(data);
+  uint64_t h = seed;
+  for (size_t i = 0; i < size; i++) {
+    h = (h ^ bytes[i]) * 1099511628211ull;
+  }
+  return h;
+}
+
+uint64_t platform(uint64_t seed) {
+  const uint32_t order = 0x01020304;
+  const size_t layout[] = {sizeof(void*),
+                           sizeof(size_t),
+                           sizeof(int),
+                           sizeof(long),
+                           sizeof(float),
+                           sizeof(double),
+                           alignof(uint64_t),
+                           alignof(double),
+                           alignof(std::max_align_t)};
+
+#if defined(__VERSION__)
+  const std::string compiler = __VERSION__;
+#elif defined(_MSC_FULL_VER)
+  const std::string compiler = std::to_string(_MSC_FULL_VER);
+#else
+  const std::string compiler = "unknown";
+#endif
+
+  uint64_t h = hash(&order, sizeof(order), seed);
+  h = hash(layout, sizeof(layout), h);
+  return hash(compiler.data(), compiler.size(), h);
+}
+
+/**
+ * ============================================================
+ *                             File
+ * ============================================================
+ */
+
+File::File(const std::string& path) {
+#ifdef CACHE_MMAP
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    throw std::runtime_error("Could not open " + path + ".");
+  }
+
+  struct stat info;
+  if (fstat(fd, &info) == 0 && info.st_size > 0) {
+    void* ptr = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (ptr != MAP_FAILED) {
+      begin = static_cast<const char*>(ptr);
+      length = info.st_size;
+      mapped = true;
+    }
+  }
+
+  close(fd);
+
+  if (mapped) {
+    return;
+  }
+#endif
+
+  // Fall back to reading the whole file.
+  std::ifstream in(path, std::ios::binary);
+  if (!in) {
+    throw std::runtime_error("Could not open " + path + ".");
+  }
+
+  buffer.assign(std::istreambuf_iterator<char>(in),
+                std::istreambuf_iterator<char>());
+  begin = buffer.data();
+  length = buffer.size();
+}
+
+File::~File() {
+#ifdef CACHE_MMAP
+  if (mapped) {
+    munmap(const_cast<char*>(begin), length);
+  }
+#endif
+}
+
+const char* File::data() const {
+  return begin;
+}
+
+size_t File::size() const {
+  return length;
+}
+
+/**
+ * ============================================================
+ *                             Reader
+ * ============================================================
+ */
+
+Reader::Reader(const File& file)
+    : it(file.data()), end(file.data() + file.size()) {}
+
+std::string Reader::read_string() {
+  std::vector<char> chars;
+  read(chars);
+  return std::string(chars.begin(), chars.end());
+}
+
+void Reader::take(void* out, size_t size) {
+  if (static_cast<size_t>(end - it) < size) {
+    throw std::runtime_error("Unexpected end of cache file.");
+  }
+
+  if (size > 0) {
+    std::memcpy(out, it, size);
+    it += size;
+  }
+}
+
+/**
+ * ============================================================
+ *                             Writer
+ * ============================================================
+ */
+
+Writer::Writer(const std::string& path)
+    : path(path),
+      temp(path + ".tmp" + std::to_string(std::random_device()())),
+      out(temp, std::ios::binary | std::ios::trunc) {
+  if (!out) {
+    throw std::runtime_error("Could not create " + temp + ".");
+  }
+}
+
+Writer::~Writer() {
+  // Discard the temporary file if the cache was never committed.
+  if (!committed) {
+    out.close();
+    std::remove(temp.c_str());
+  }
+}
+
+void Writer::write_string(const std::string& value) {
+  write(std::vector<char>(value.begin(), value.end()));
+}
+
+void Writer::commit() {
+  out.close();
+
+  if (!out || std::rename(temp.c_str(), path.c_str()) != 0) {
+    throw std::runtime_error("Could not write " + path + ".");
+  }
+
+  committed = true;
+}
+
+void Writer::put(const void* data, size_t size) {
+  out.write(static_cast<const char*>(data), size);
+}
+}  // namespace cache
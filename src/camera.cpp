@@ -1,10 +1,5 @@
 #include "camera.hpp"
 
-Camera::Camera() {
-  std::random_device rd;
-  this->gen = std::mt19937(rd());
-}
-
 void Camera::set_position(glm::vec3 P, glm::vec3 C, glm::vec3 U) {
   this->P = P;
 
@@ -23,9 +18,7 @@ void Camera::set_view(float fovy, int width, int height) {
  * Tent-filter anti-aliasing based on inverse of tent CDF.
  * http://blog.mir.dlang.io/random/2016/08/19/intro-to-random-sampling.html
  */
-Ray Camera::pixel_ray(int x, int y) const {
-  static std::uniform_real_distribution<float> dist(0, 1);
-
+Ray Camera::pixel_ray(int x, int y, Sampler& sampler) const {
   // tan(fovy * 0.5) = (height / 2) / d -> d = height / (2 * tan(fovy * 0.5))
   float d = height / (2 * glm::tan(fovy * 0.5));
 
@@ -37,8 +30,9 @@ Ray Camera::pixel_ray(int x, int y) const {
 
   // There are many rays that go through a pixel - choose one randomly
   // (weighted at center) for an aliasing effect.
-  float u = 2 * dist(gen);
-  float v = 2 * dist(gen);
+  glm::vec2 uv = 2.0f * sampler.next_2d();
+  float u = uv.x;
+  float v = uv.y;
 
   // The square root skews the samples towards the center. CDF of tent is
   // C(x) = x^2 so inverse is sqrt(x). Symmetry can be applied to opposite
@@ -10,15 +10,39 @@ void from_json(const nlohmann::json& json, Config& config) {
   config.camera.fovy = json["camera"]["fovy"].get<float>();
 
   config.job.threads = json["job"]["threads"].get<int>();
-  config.job.partitions = json["job"]["partitions"].get<int>();
+  config.job.affinity = json["job"]["affinity"].get<std::string>();
+  config.job.replicate = json["job"]["replicate"].get<bool>();
+  config.job.tile = json["job"]["tile"].get<int>();
+  config.job.order = json["job"]["order"].get<std::string>();
+  config.job.batch = json["job"]["batch"].get<int>();
+  config.job.time_limit = json["job"]["time_limit"].get<float>();
 
   config.rendering.bounces = json["rendering"]["bounces"].get<int>();
   config.rendering.samples = json["rendering"]["samples"].get<int>();
   config.rendering.epsilon = json["rendering"]["epsilon"].get<float>();
   config.rendering.background = json["rendering"]["background"].get<Color>();
+  config.rendering.seed = json["rendering"]["seed"].get<uint64_t>();
+  config.rendering.sampler = json["rendering"]["sampler"].get<std::string>();
+  config.rendering.integrator =
+      json["rendering"]["integrator"].get<std::string>();
+  config.rendering.sort = json["rendering"]["sort"].get<bool>();
+  config.rendering.mis = json["rendering"]["mis"].get<bool>();
+
+  config.adaptive.threshold = json["adaptive"]["threshold"].get<float>();
+  config.adaptive.min_samples = json["adaptive"]["min_samples"].get<int>();
+  config.adaptive.max_samples = json["adaptive"]["max_samples"].get<int>();
+  config.adaptive.heatmap = json["adaptive"]["heatmap"].get<bool>();
 
   config.loader.textures = json["loader"]["textures"].get<bool>();
   config.loader.normals = json["loader"]["normals"].get<bool>();
+  config.loader.cache = json["loader"]["cache"].get<std::string>();
+
+  config.bvh.builder = json["bvh"]["builder"].get<std::string>();
+  config.bvh.width = json["bvh"]["width"].get<int>();
+  config.bvh.leaf_size = json["bvh"]["leaf_size"].get<int>();
+  config.bvh.max_depth = json["bvh"]["max_depth"].get<int>();
+  config.bvh.bins = json["bvh"]["bins"].get<int>();
+  config.bvh.watertight = json["bvh"]["watertight"].get<bool>();
 
   config.debug.normals = json["debug"]["normals"].get<bool>();
   config.debug.diffuse = json["debug"]["diffuse"].get<bool>();
@@ -0,0 +1,57 @@
+#include "deque.hpp"
+
+Deque::Deque(size_t capacity) : top(0), bottom(0) {
+  size_t size = 1;
+  while (size < capacity) {
+    size *= 2;
+  }
+
+  mask = size - 1;
+  buffer.reset(new std::atomic<int>[size]);
+}
+
+void Deque::push(int value) {
+  int64_t b = bottom.load(std::memory_order_relaxed);
+  buffer[b & mask].store(value, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  bottom.store(b + 1, std::memory_order_relaxed);
+}
+
+bool Deque::pop(int& value) {
+  int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+  bottom.store(b, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  int64_t t = top.load(std::memory_order_relaxed);
+
+  if (t > b) {
+    // Empty so restore the bottom.
+    bottom.store(b + 1, std::memory_order_relaxed);
+    return false;
+  }
+
+  value = buffer[b & mask].load(std::memory_order_relaxed);
+
+  if (t == b) {
+    // Last element so race the thieves for it.
+    bool won = top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                           std::memory_order_relaxed);
+    bottom.store(b + 1, std::memory_order_relaxed);
+    return won;
+  }
+
+  return true;
+}
+
+bool Deque::steal(int& value) {
+  int64_t t = top.load(std::memory_order_acquire);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  int64_t b = bottom.load(std::memory_order_acquire);
+
+  if (t >= b) {
+    return false;
+  }
+
+  value = buffer[t & mask].load(std::memory_order_relaxed);
+  return top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                     std::memory_order_relaxed);
+}
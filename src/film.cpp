@@ -0,0 +1,126 @@
+#include "film.hpp"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+constexpr double Film::DARK;
+
+Film::Film(size_t width, size_t height)
+    : width(width), height(height), pixels(new Pixel[width * height]) {
+  for (size_t i = 0; i < width * height; i++) {
+    pixels[i].sequence = 0;
+    pixels[i].samples = 0;
+    pixels[i].r = 0;
+    pixels[i].g = 0;
+    pixels[i].b = 0;
+    pixels[i].squared = 0;
+  }
+}
+
+void Film::add(size_t x, size_t y, const Color& sum, double squared,
+               uint32_t samples) {
+  Pixel& pixel = pixels[y * width + x];
+
+  // There is a single writer per pixel so the fields can be updated with
+  // relaxed loads and stores instead of read-modify-writes.
+  uint32_t sequence = pixel.sequence.load(std::memory_order_relaxed);
+  pixel.sequence.store(sequence + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+
+  auto increment = [](std::atomic<double>& channel, double value) {
+    channel.store(channel.load(std::memory_order_relaxed) + value,
+                  std::memory_order_relaxed);
+  };
+
+  increment(pixel.r, sum.r);
+  increment(pixel.g, sum.g);
+  increment(pixel.b, sum.b);
+  increment(pixel.squared, squared);
+  pixel.samples.store(pixel.samples.load(std::memory_order_relaxed) + samples,
+                      std::memory_order_relaxed);
+
+  pixel.sequence.store(sequence + 2, std::memory_order_release);
+}
+
+uint32_t Film::samples(size_t x, size_t y) const {
+  return pixels[y * width + x].samples.load(std::memory_order_relaxed);
+}
+
+double Film::error(size_t x, size_t y) const {
+  double sum[3];
+  double squared;
+  uint32_t samples;
+  read(pixels[y * width + x], sum, squared, samples);
+
+  if (samples < 2) {
+    return std::numeric_limits<double>::infinity();
+  }
+
+  double n = samples;
+  double mean = (sum[0] + sum[1] + sum[2]) / (3 * n);
+  double variance = std::max(0.0, (squared / n - mean * mean) * n / (n - 1));
+
+  return std::sqrt(variance / n) / std::max(mean, DARK);
+}
+
+Image Film::resolve() const {
+  Image image(width, height);
+
+  for (size_t i = 0; i < width * height; i++) {
+    double sum[3];
+    double squared;
+    uint32_t samples;
+    read(pixels[i], sum, squared, samples);
+
+    if (samples > 0) {
+      image.set_pixel(i, Color(sum[0] / samples, sum[1] / samples,
+                               sum[2] / samples));
+    }
+  }
+
+  return image;
+}
+
+Image Film::heatmap() const {
+  Image image(width, height);
+
+  uint32_t most = 1;
+  for (size_t i = 0; i < width * height; i++) {
+    most = std::max(most, pixels[i].samples.load(std::memory_order_relaxed));
+  }
+
+  for (size_t i = 0; i < width * height; i++) {
+    float f = pixels[i].samples.load(std::memory_order_relaxed) /
+              static_cast<float>(most);
+    image.set_pixel(i, Color(f, f, f));
+  }
+
+  return image;
+}
+
+size_t Film::get_width() const {
+  return width;
+}
+
+size_t Film::get_height() const {
+  return height;
+}
+
+void Film::read(const Pixel& pixel, double sum[3], double& squared,
+                uint32_t& samples) const {
+  uint32_t before;
+  uint32_t after;
+
+  do {
+    before = pixel.sequence.load(std::memory_order_acquire);
+
+    sum[0] = pixel.r.load(std::memory_order_relaxed);
+    sum[1] = pixel.g.load(std::memory_order_relaxed);
+    sum[2] = pixel.b.load(std::memory_order_relaxed);
+    squared = pixel.squared.load(std::memory_order_relaxed);
+    samples = pixel.samples.load(std::memory_order_relaxed);
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+    after = pixel.sequence.load(std::memory_order_relaxed);
+  } while ((before & 1) || before != after);
+}
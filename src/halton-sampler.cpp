@@ -0,0 +1,50 @@
+#include "halton-sampler.hpp"
+#include <algorithm>
+#include <cmath>
+
+constexpr int HaltonSampler::DIMENSIONS;
+
+const uint32_t HaltonSampler::PRIMES[DIMENSIONS] = {
+    2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37, 41, 43, 47, 53};
+
+HaltonSampler::HaltonSampler(uint64_t seed)
+    : seed(seed), sample(0), dimension(0) {}
+
+void HaltonSampler::start(uint32_t pixel, uint32_t sample) {
+  this->sample = sample;
+  dimension = 0;
+  rotation = RNG::pixel(seed, pixel);
+  rng = RNG::sample(seed, pixel, sample);
+}
+
+float HaltonSampler::next_1d() {
+  if (dimension >= DIMENSIONS) {
+    return rng.uniform();
+  }
+
+  float x = radical_inverse(PRIMES[dimension++], sample) + rotation.uniform();
+  x = x >= 1 ? x - 1 : x;
+
+  // Rounding the sum may give exactly 1.
+  return std::min(x, std::nextafter(1.0f, 0.0f));
+}
+
+glm::vec2 HaltonSampler::next_2d() {
+  float u = next_1d();
+  float v = next_1d();
+  return glm::vec2(u, v);
+}
+
+float HaltonSampler::radical_inverse(uint32_t base, uint32_t index) {
+  double inverse = 1.0 / base;
+  double factor = inverse;
+  double result = 0;
+
+  while (index > 0) {
+    result += (index % base) * factor;
+    index /= base;
+    factor *= inverse;
+  }
+
+  return static_cast<float>(result);
+}
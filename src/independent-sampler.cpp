@@ -0,0 +1,17 @@
+#include "independent-sampler.hpp"
+
+IndependentSampler::IndependentSampler(uint64_t seed) : seed(seed) {}
+
+void IndependentSampler::start(uint32_t pixel, uint32_t sample) {
+  rng = RNG::sample(seed, pixel, sample);
+}
+
+float IndependentSampler::next_1d() {
+  return rng.uniform();
+}
+
+glm::vec2 IndependentSampler::next_2d() {
+  float u = rng.uniform();
+  float v = rng.uniform();
+  return glm::vec2(u, v);
+}
@@ -8,6 +8,7 @@
 #include "png-saver.hpp"
 #include "renderer.hpp"
 #include "scene.hpp"
+#include "topology.hpp"
 
 int main(int argc, char* argv[]) {
   // Setup CLI.
@@ -53,16 +54,77 @@ int main(int argc, char* argv[]) {
     return 1;
   }
 
-  if (config.job.threads < 1) {
-    std::cerr << "Please specify at least 1 render thread." << std::endl;
+  if (config.job.threads < 0) {
+    std::cerr << "Please specify 0 render threads to use every CPU or more."
+              << std::endl;
     return 1;
-  } else if (config.job.partitions < 1) {
-    std::cerr << "Please specify at least 1 partition." << std::endl;
+  } else if (config.job.affinity != "none" &&
+             config.job.affinity != "compact" &&
+             config.job.affinity != "scatter") {
+    std::cerr << "Please specify a none, compact or scatter thread affinity."
+              << std::endl;
+    return 1;
+  } else if (config.job.replicate && config.job.affinity == "none") {
+    std::cerr << "Please pin the render threads to replicate the scene."
+              << std::endl;
+    return 1;
+  } else if (config.job.tile < 1) {
+    std::cerr << "Please specify a positive tile size." << std::endl;
+    return 1;
+  } else if (config.job.order != "scanline" && config.job.order != "morton" &&
+             config.job.order != "hilbert") {
+    std::cerr << "Please specify a scanline, morton or hilbert tile order."
+              << std::endl;
+    return 1;
+  } else if (config.job.batch < 1) {
+    std::cerr << "Please specify a positive sample batch." << std::endl;
+    return 1;
+  } else if (config.job.time_limit < 0) {
+    std::cerr << "Please specify a time limit of 0 or more seconds."
+              << std::endl;
+    return 1;
+  } else if (config.rendering.sampler != "independent" &&
+             config.rendering.sampler != "halton" &&
+             config.rendering.sampler != "sobol") {
+    std::cerr << "Please specify an independent, halton or sobol sampler."
+              << std::endl;
+    return 1;
+  } else if (config.rendering.integrator != "path" &&
+             config.rendering.integrator != "wavefront") {
+    std::cerr << "Please specify a path or wavefront integrator." << std::endl;
+    return 1;
+  } else if (config.adaptive.threshold < 0 ||
+             config.adaptive.min_samples < 1 ||
+             config.adaptive.max_samples < config.adaptive.min_samples) {
+    std::cerr << "Please specify a positive adaptive threshold and at least "
+              << "as many maximum as minimum adaptive samples." << std::endl;
+    return 1;
+  } else if (config.bvh.builder != "midpoint" && config.bvh.builder != "sah" &&
+             config.bvh.builder != "lbvh") {
+    std::cerr << "Please specify a midpoint, sah or lbvh BVH builder."
+              << std::endl;
+    return 1;
+  } else if (config.bvh.width != 2 && config.bvh.width != 4 &&
+             config.bvh.width != 8) {
+    std::cerr << "Please specify a BVH width of 2, 4 or 8." << std::endl;
+    return 1;
+  } else if (config.bvh.leaf_size < 1 || config.bvh.max_depth < 0 ||
+             config.bvh.max_depth > BVH::MAX_DEPTH) {
+    std::cerr << "Please specify a positive BVH leaf size and a depth of at "
+              << "most " << BVH::MAX_DEPTH << "." << std::endl;
+    return 1;
+  } else if (config.bvh.bins < 2) {
+    std::cerr << "Please specify at least 2 SAH bins." << std::endl;
     return 1;
   } else if (config.debug.normals || config.debug.diffuse) {
     config.rendering.samples = 1;
   }
 
+  // Use every CPU unless told otherwise. The BVH build uses the same count.
+  if (config.job.threads == 0) {
+    config.job.threads = Topology::detect().cpus();
+  }
+
   // Parse scene.
   Scene scene;
 
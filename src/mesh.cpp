@@ -0,0 +1,86 @@
+#include "mesh.hpp"
+#include <glm/glm.hpp>
+#include <limits>
+#include "triangle.hpp"
+
+Mesh::Intersection::operator bool() const {
+  return t >= 0;
+}
+
+uint32_t Mesh::add(Vertex a, Vertex b, Vertex c, uint32_t m) {
+  indices.push_back(a);
+  indices.push_back(b);
+  indices.push_back(c);
+  materials.push_back(m);
+  return materials.size() - 1;
+}
+
+uint32_t Mesh::size() const {
+  return materials.size();
+}
+
+Mesh::Intersection Mesh::intersects(uint32_t id, const Ray& ray) const {
+  Triangle::Hit hit;
+  Triangle triangle = Triangle::edges(vert(id, 0), vert(id, 1), vert(id, 2));
+
+  if (!triangle.intersect(ray, std::numeric_limits<float>::infinity(), hit)) {
+    return NO_INTER();
+  }
+
+  return interpolate(id, ray, hit.t, hit.u, hit.v);
+}
+
+bool Mesh::occludes(uint32_t id, const Ray& ray, float tmax) const {
+  Triangle::Hit hit;
+  Triangle triangle = Triangle::edges(vert(id, 0), vert(id, 1), vert(id, 2));
+  return triangle.intersect(ray, tmax, hit);
+}
+
+Mesh::Intersection Mesh::interpolate(uint32_t id, const Ray& ray, float t,
+                                     float u, float v) const {
+  const Vertex& a = indices[3 * id];
+  const Vertex& b = indices[3 * id + 1];
+  const Vertex& c = indices[3 * id + 2];
+
+  float w = 1 - u - v;
+
+  glm::vec3 N;
+  if (a.n != -1 && b.n != -1 && c.n != -1) {
+    // Interpolate only if all vertex normals specified
+    N = w * this->N[a.n] + u * this->N[b.n] + v * this->N[c.n];
+  } else {
+    // Otherwise flip direction if ray hitting opposite side
+    N = glm::cross(V[b.v] - V[a.v], V[c.v] - V[a.v]);
+    if (glm::dot(N, ray.D) > 0) {
+      N *= -1;
+    }
+  }
+
+  // Calculate texture coordinates
+  glm::vec2 uv;
+  if (has_texture_coords(id)) {
+    uv = w * T[a.t] + u * T[b.t] + v * T[c.t];
+  }
+
+  return Intersection{t, glm::normalize(N), uv};
+}
+
+BoundingBox Mesh::bounds(uint32_t id) const {
+  BoundingBox box(vert(id, 0));
+  box.expand(vert(id, 1));
+  box.expand(vert(id, 2));
+  return box;
+}
+
+const Material& Mesh::material(uint32_t id) const {
+  return M[materials[id]];
+}
+
+bool Mesh::has_texture_coords(uint32_t id) const {
+  return indices[3 * id].t != -1 && indices[3 * id + 1].t != -1 &&
+         indices[3 * id + 2].t != -1;
+}
+
+const glm::vec3& Mesh::vert(uint32_t id, int i) const {
+  return V[indices[3 * id + i].v];
+}
@@ -1,16 +1,22 @@
 #define TINYOBJLOADER_IMPLEMENTATION
 
 #include "parser.hpp"
+#include <algorithm>
+#include <cctype>
 #include <memory>
 #include <string>
 #include <vector>
 #include "area-light.hpp"
 #include "glm/glm.hpp"
+#include "mesh.hpp"
 #include "scene.hpp"
-#include "triangle.hpp"
 
 std::shared_ptr<spdlog::logger> Parser::LOG = spdlog::stdout_color_mt("Parser");
 
+constexpr uint64_t Parser::CACHE_MAGIC;
+
+constexpr uint64_t Parser::CACHE_VERSION;
+
 Parser::Parser(Config config) : config(config) {}
 
 Scene Parser::parse(std::string scene_file,
@@ -27,6 +33,30 @@ Scene Parser::parse(std::string scene_file,
     materials_path += "/";
   }
 
+  // Try the cache before parsing the scene.
+  std::string cache_file;
+  uint64_t key = 0;
+
+  if (!config.loader.cache.empty()) {
+    cache_file = config.loader.cache + "/" +
+                 scene_file.substr(scene_file.find_last_of("/\\") + 1) +
+                 ".cache";
+
+    try {
+      key = cache_key(scene_file, materials_path);
+
+      Scene scene;
+      if (load_cache(cache_file, key, scene)) {
+        log_bounds(scene);
+        return scene;
+      }
+
+      LOG->info("Cache {:s} is stale.", cache_file);
+    } catch (std::runtime_error e) {
+      LOG->info(e.what());
+    }
+  }
+
   Scene scene;
 
   LOG->info("Loading {:s}...", scene_file);
@@ -40,38 +70,39 @@ Scene Parser::parse(std::string scene_file,
     LOG->warn(error);
   }
 
-  // Begin by loading vertices...
-  auto V = std::make_shared<std::vector<glm::vec3>>();
+  auto mesh = std::make_shared<Mesh>();
+  auto& V = mesh->V;
+  auto& N = mesh->N;
+  auto& T = mesh->T;
+  auto& M = mesh->M;
 
+  // Begin by loading vertices...
   for (size_t i = 0; i < attrib.vertices.size() / 3; i++) {
-    V->push_back(to_vec(attrib.vertices.data() + i * 3));
+    V.push_back(to_vec(attrib.vertices.data() + i * 3));
   }
 
-  LOG->info("Loaded {:d} vertices.", V->size());
+  LOG->info("Loaded {:d} vertices.", V.size());
 
   // Then load normals...
-  auto N = std::make_shared<std::vector<glm::vec3>>();
-
   for (size_t i = 0; i < attrib.normals.size() / 3; i++) {
-    N->push_back(to_vec(attrib.normals.data() + i * 3));
+    N.push_back(to_vec(attrib.normals.data() + i * 3));
   }
 
-  LOG->info("Loaded {:d} normals.", N->size());
+  LOG->info("Loaded {:d} normals.", N.size());
 
   // Then the texture coordinates...
-  auto T = std::make_shared<std::vector<glm::vec2>>();
-
   for (size_t i = 0; i < attrib.texcoords.size() / 2; i++) {
-    T->emplace_back(attrib.texcoords[i * 2], attrib.texcoords[i * 2 + 1]);
+    T.emplace_back(attrib.texcoords[i * 2], attrib.texcoords[i * 2 + 1]);
   }
 
-  LOG->info("Loaded {:d} texture coordinates.", T->size());
+  LOG->info("Loaded {:d} texture coordinates.", T.size());
 
   // Now load the materials...
-  auto M = std::make_shared<std::vector<Material>>();
   Material def;
   def.Ke = Color(1, 0, 0);
-  M->push_back(def);
+  M.push_back(def);
+
+  std::vector<std::string> texture_files(1);
 
   for (size_t i = 0; i < materials.size(); i++) {
     Material m;
@@ -86,19 +117,19 @@ Scene Parser::parse(std::string scene_file,
     m.Ni = materials[i].ior;
 
     // Load textures...
+    std::string texture_file;
     if (config.loader.textures && !materials[i].diffuse_texname.empty()) {
-      m.Kd_texture =
-          load_texture(materials_path + "/" + materials[i].diffuse_texname);
+      texture_file = materials_path + "/" + materials[i].diffuse_texname;
+      m.Kd_texture = load_texture(texture_file);
     }
 
-    M->push_back(m);
+    M.push_back(m);
+    texture_files.push_back(texture_file);
   }
 
-  LOG->info("Loaded {:d} materials.", M->size());
+  LOG->info("Loaded {:d} materials.", M.size());
 
   // Finally load the triangles...
-  std::vector<Primitive::SharedPtr> S;
-
   for (size_t i = 0; i < shapes.size(); i++) {
     for (size_t j = 0; j < shapes[i].mesh.num_face_vertices.size(); j++) {
       // We only support triangulated meshes.
@@ -106,16 +137,14 @@ Scene Parser::parse(std::string scene_file,
         throw std::logic_error("Mesh contains a non-triangular face!");
       }
 
-      int pid = S.size();
-
       const std::vector<tinyobj::index_t>& indices = shapes[i].mesh.indices;
 
       auto av = indices[j * 3 + 0].vertex_index;
       auto bv = indices[j * 3 + 1].vertex_index;
       auto cv = indices[j * 3 + 2].vertex_index;
 
-      if (av < 0 || bv < 0 || cv < 0 || av >= V->size() || bv >= V->size() ||
-          cv >= V->size()) {
+      if (av < 0 || bv < 0 || cv < 0 || av >= V.size() || bv >= V.size() ||
+          cv >= V.size()) {
         LOG->error("Mesh {:d} of shape {:d} has invalid vertex.", j, i);
         continue;
       }
@@ -125,8 +154,8 @@ Scene Parser::parse(std::string scene_file,
       auto bn = indices[j * 3 + 1].normal_index;
       auto cn = indices[j * 3 + 2].normal_index;
 
-      if (an < 0 || bn < 0 || cn < 0 || an >= N->size() || bn >= N->size() ||
-          cn >= N->size() || !config.loader.normals) {
+      if (an < 0 || bn < 0 || cn < 0 || an >= N.size() || bn >= N.size() ||
+          cn >= N.size() || !config.loader.normals) {
         an = -1;
         bn = -1;
         cn = -1;
@@ -137,8 +166,8 @@ Scene Parser::parse(std::string scene_file,
       auto bt = indices[j * 3 + 1].texcoord_index;
       auto ct = indices[j * 3 + 2].texcoord_index;
 
-      if (at < 0 || bt < 0 || ct < 0 || at >= T->size() || bt >= T->size() ||
-          ct >= T->size()) {
+      if (at < 0 || bt < 0 || ct < 0 || at >= T.size() || bt >= T.size() ||
+          ct >= T.size()) {
         at = -1;
         bt = -1;
         ct = -1;
@@ -158,28 +187,28 @@ Scene Parser::parse(std::string scene_file,
         m++;
       }
 
-      auto triangle = std::make_shared<Triangle>(a, b, c, m, V, N, M, T);
-
-      S.push_back(triangle);
-
-      // Index the object as a light if it the material has emission.
-      if (!M->at(m).Ke.isBlack()) {
-        scene.lights.emplace_back(new AreaLight(triangle));
-      }
+      mesh->add(a, b, c, m);
     }
   }
 
-  LOG->info("Loaded {:d} triangles.", S.size());
+  LOG->info("Loaded {:d} triangles.", mesh->size());
 
-  if (S.empty()) {
+  if (mesh->size() == 0) {
     return scene;
   }
 
-  scene.bvh = BVH::build(std::move(S));
+  scene.bvh = BVH::build(mesh, config);
+  add_lights(scene, mesh);
+  log_bounds(scene);
 
-  BoundingBox box = scene.bvh.get_bounds();
-  LOG->info("Bounds: [{:.2f}, {:.2f}] x [{:.2f}, {:.2f}] x [{:.2f}, {:.2f}]",
-            box.min.x, box.max.x, box.min.y, box.max.y, box.min.z, box.max.z);
+  if (!cache_file.empty()) {
+    try {
+      save_cache(cache_file, key, scene, texture_files);
+      LOG->info("Cached scene in {:s}.", cache_file);
+    } catch (std::runtime_error e) {
+      LOG->warn(e.what());
+    }
+  }
 
   return scene;
 }
@@ -197,6 +226,156 @@ void Parser::reset() {
   textures.clear();
 }
 
+uint64_t Parser::cache_key(const std::string& scene_file,
+                          const std::string& materials_path) const {
+  uint64_t h = cache::hash(&CACHE_VERSION, sizeof(CACHE_VERSION));
+  h = cache::platform(h);
+
+  cache::File scene(scene_file);
+  h = cache::hash(scene.data(), scene.size(), h);
+
+  // Hash the material libraries referenced by mtllib statements.
+  const char* it = scene.data();
+  const char* end = scene.data() + scene.size();
+
+  while (it < end) {
+    const char* eol = std::find(it, end, '\n');
+
+    std::string line(it, eol);
+    if (line.compare(0, 7, "mtllib ") == 0) {
+      size_t pos = 7;
+      while (pos < line.size()) {
+        while (pos < line.size() && std::isspace(line[pos])) {
+          pos++;
+        }
+        size_t next = pos;
+        while (next < line.size() && !std::isspace(line[next])) {
+          next++;
+        }
+        if (next > pos) {
+          std::string name = line.substr(pos, next - pos);
+          h = cache::hash(name.data(), name.size(), h);
+          try {
+            cache::File library(materials_path + name);
+            h = cache::hash(library.data(), library.size(), h);
+          } catch (std::runtime_error e) {
+            // The OBJ loader reports missing libraries.
+          }
+        }
+        pos = next;
+      }
+    }
+
+    it = eol + 1;
+  }
+
+  // Then the settings which affect the loaded scene.
+  h = cache::hash(&config.loader.textures, sizeof(bool), h);
+  h = cache::hash(&config.loader.normals, sizeof(bool), h);
+  h = cache::hash(config.bvh.builder.data(), config.bvh.builder.size(), h);
+  h = cache::hash(&config.bvh.width, sizeof(int), h);
+  h = cache::hash(&config.bvh.leaf_size, sizeof(int), h);
+  h = cache::hash(&config.bvh.max_depth, sizeof(int), h);
+  h = cache::hash(&config.bvh.bins, sizeof(int), h);
+
+  return h;
+}
+
+bool Parser::load_cache(const std::string& cache_file, uint64_t key,
+                        Scene& scene) {
+  cache::File file(cache_file);
+  cache::Reader reader(file);
+
+  if (reader.read<uint64_t>() != CACHE_MAGIC ||
+      reader.read<uint64_t>() != key) {
+    return false;
+  }
+
+  auto mesh = std::make_shared<Mesh>();
+
+  reader.read(mesh->V);
+  reader.read(mesh->N);
+  reader.read(mesh->T);
+
+  mesh->M.resize(reader.read<uint64_t>());
+  for (Material& m : mesh->M) {
+    m.Ke = reader.read<Color>();
+    m.Ka = reader.read<Color>();
+    m.Kd = reader.read<Color>();
+    m.Ks = reader.read<Color>();
+    m.Kt = reader.read<Color>();
+    m.Ni = reader.read<float>();
+    m.Pr = reader.read<float>();
+
+    std::string texture_file = reader.read_string();
+    if (!texture_file.empty()) {
+      m.Kd_texture = load_texture(texture_file);
+    }
+  }
+
+  reader.read(mesh->indices);
+  reader.read(mesh->materials);
+
+  scene.bvh = BVH::read(reader, mesh, config);
+  add_lights(scene, mesh);
+
+  if (reader.read<uint64_t>() != CACHE_MAGIC) {
+    throw std::runtime_error("Corrupt cache " + cache_file + ".");
+  }
+
+  LOG->info("Loaded {:d} triangles from {:s}.", mesh->size(), cache_file);
+
+  return true;
+}
+
+void Parser::save_cache(const std::string& cache_file, uint64_t key,
+                        const Scene& scene,
+                        const std::vector<std::string>& texture_files) const {
+  const Mesh& mesh = scene.bvh.get_mesh();
+
+  cache::Writer writer(cache_file);
+  writer.write(CACHE_MAGIC);
+  writer.write(key);
+
+  writer.write(mesh.V);
+  writer.write(mesh.N);
+  writer.write(mesh.T);
+
+  writer.write<uint64_t>(mesh.M.size());
+  for (size_t i = 0; i < mesh.M.size(); i++) {
+    const Material& m = mesh.M[i];
+    writer.write(m.Ke);
+    writer.write(m.Ka);
+    writer.write(m.Kd);
+    writer.write(m.Ks);
+    writer.write(m.Kt);
+    writer.write(m.Ni);
+    writer.write(m.Pr);
+    writer.write_string(texture_files[i]);
+  }
+
+  writer.write(mesh.indices);
+  writer.write(mesh.materials);
+  scene.bvh.write(writer);
+  writer.write(CACHE_MAGIC);
+  writer.commit();
+}
+
+void Parser::add_lights(Scene& scene, std::shared_ptr<const Mesh> mesh) {
+  for (uint32_t i = 0; i < mesh->size(); i++) {
+    // Index the triangle as a light if it the material has emission.
+    if (!mesh->material(i).Ke.isBlack()) {
+      scene.lights.emplace_back(new AreaLight(mesh, i));
+    }
+  }
+}
+
+void Parser::log_bounds(const Scene& scene) {
+  BoundingBox box = scene.bvh.get_bounds();
+  LOG->info("Bounds: [{:.2f}, {:.2f}] x [{:.2f}, {:.2f}] x [{:.2f}, {:.2f}]",
+            box.min.x, box.max.x, box.min.y, box.max.y, box.min.z, box.max.z);
+}
+
 Color Parser::to_color(const tinyobj::real_t* color) {
   return Color(color[0], color[1], color[2]);
 }
@@ -2,42 +2,74 @@
 #include <algorithm>
 #include <cassert>
 #include <glm/gtc/constants.hpp>
-#include <limits>
+#include "area-light.hpp"
 #include "samplers.hpp"
 
-PathTracer::PathTracer(Config config) : config(std::move(config)) {
-  std::random_device rd;
-  this->gen = std::mt19937(rd());
+PathTracer::PathTracer(Config config) : config(std::move(config)) {}
+
+Color PathTracer::trace(const Scene& scene, const Ray& ray,
+                        Sampler& sampler) const {
+  Path path = start(ray);
+
+  while (true) {
+    Shadow shadow;
+    bool alive = shade(scene, scene.bvh.intersect(path.ray), path, shadow,
+                       sampler);
+
+    if (shadow.tmax > 0 &&
+        !scene.bvh.occluded(Ray(shadow.O, shadow.D), shadow.tmax)) {
+      path.radiance += shadow.contribution;
+    }
+
+    if (!alive) {
+      return path.radiance;
+    }
+  }
 }
 
-Color PathTracer::trace(const Scene& scene, const Ray& ray) const {
-  return trace(scene, ray, 0, true);
+PathTracer::Path PathTracer::start(const Ray& ray) const {
+  return Path{ray, Color(1, 1, 1), Color::BLACK, 0, true, 0};
 }
 
-Color PathTracer::trace(const Scene& scene, const Ray& ray, int depth,
-                        bool emission) const {
-  static std::uniform_real_distribution<float> fdist(0.0f, 1.01f);
+bool PathTracer::shade(const Scene& scene, const BVH::Intersection& inter,
+                       Path& path, Shadow& shadow, Sampler& sampler) const {
+  auto fdist = [&sampler]() { return 1.01f * sampler.next_1d(); };
+  Ray ray = path.ray;
 
-  auto inter = scene.bvh.intersect(ray);
   if (!inter) {
-    return config.rendering.background;
+    path.radiance += path.throughput * config.rendering.background;
+    return false;
   }
 
-  const Material& mat = inter.primitive->material();
+  const Mesh& mesh = scene.bvh.get_mesh();
+  const Material& mat = mesh.material(inter.triangle);
 
   // Check if we are using a diffuse texture.
-  bool use_texture = (inter.primitive->has_texture_coords() && mat.Kd_texture);
+  bool use_texture =
+      (mesh.has_texture_coords(inter.triangle) && mat.Kd_texture);
 
   Color Kd = use_texture ? mat.Kd_texture->get_pixel_uv(inter.uv.x, inter.uv.y)
                          : mat.Kd;
 
   if (config.debug.normals) {
     auto N = (inter.N + 1.f) * 0.5f;
-    return Color(N.x, N.y, N.z);
+    path.radiance += path.throughput * Color(N.x, N.y, N.z);
+    return false;
   } else if (config.debug.diffuse && !Kd.isTransparent()) {
-    return Kd;
+    path.radiance += path.throughput * Kd;
+    return false;
   } else if (!mat.Ke.isBlack()) {
-    return emission ? mat.Ke : Color::BLACK;
+    if (path.emission) {
+      // Weigh the emission against a direct light sample of the previous
+      // vertex finding the same point.
+      float weight = 1;
+      if (path.pdf > 0) {
+        float light = light_pdf(scene, inter.triangle, ray.O, ray.at(inter.t));
+        weight = samplers::power_heuristic(path.pdf, light);
+      }
+      path.radiance += path.throughput * mat.Ke * weight;
+    }
+    return false;
   }
 
   Shading type = Shading::NONE;
@@ -50,7 +82,7 @@ Color PathTracer::trace(const Scene& scene, const Ray& ray, int depth,
   } else if (!mat.Ks.isBlack()) {
     type = Shading::REFL_REFR;
   } else {
-    return Color::BLACK;
+    return false;
   }
 
   float p = 1.0f;
@@ -58,7 +90,7 @@ Color PathTracer::trace(const Scene& scene, const Ray& ray, int depth,
   // Russian Roulette termination - use the average color intensity as
   // termination probability. Based on:
   // https://inst.eecs.berkeley.edu/~cs294-13/fa09/lectures/scribe-lecture5.pdf
-  if (depth > config.rendering.bounces) {
+  if (path.depth > config.rendering.bounces) {
     // The probability of termination is inversely proporional to the material
     // intensity.
     switch (type) {
@@ -75,13 +107,13 @@ Color PathTracer::trace(const Scene& scene, const Ray& ray, int depth,
         assert(false);
     }
 
-    // Prevent infinite recursion for intense materials.
-    p = depth > config.rendering.bounces * 2 ? 0.0f : p;
+    // Prevent endless paths for intense materials.
+    p = path.depth > config.rendering.bounces * 2 ? 0.0f : p;
 
-    if (fdist(gen) < p) {
+    if (fdist() < p) {
       p = 1.0f / p;
     } else {
-      return Color::BLACK;
+      return false;
     }
   }
 
@@ -90,46 +122,82 @@ Color PathTracer::trace(const Scene& scene, const Ray& ray, int depth,
   glm::vec3 O = P + config.rendering.epsilon * N;
 
   // If we encounter a transparent texture, continue shooting the ray through
-  // with a 50% chance of depth increase so that we do not recurse infinitely.
+  // with a 50% chance of depth increase so that paths end eventually.
+  // Shadow rays do not pass transparent textures so emission behind them is
+  // counted in full.
   if (Kd.isTransparent() && use_texture) {
-    Ray through(P + ray.D * config.rendering.epsilon, ray.D);
-    return trace(scene, through, depth + fdist(gen) * 2, emission);
+    path.ray = Ray(P + ray.D * config.rendering.epsilon, ray.D);
+    path.depth = static_cast<int>(path.depth + fdist() * 2);
+    path.pdf = 0;
+    return true;
   }
 
-  // Directly sample a light for diffuse surfaces.
-  Color Li =
-      (type == Shading::DIFF) ? direct_light_sample(scene, O, N) : Color::BLACK;
-
-  if (type == Shading::DIFF) {
-    glm::vec3 D = samplers::cos_weighted_hemi(inter.N, gen);
-    return Kd * (Li + trace(scene, Ray(O, D), depth + 1, false) * p);
-  } else if (type == Shading::REFL_ONLY) {
-    glm::vec3 R = reflect(inter.N, ray.D, mat.Pr);
-    return mat.Ks * p * trace(scene, Ray(O, R), depth + 1, true);
-  } else if (type == Shading::REFL_REFR) {
-    glm::vec3 R = reflect(inter.N, ray.D, mat.Pr);
+  if (type == Shading::DIFF || type == Shading::REFL_ONLY) {
+    // Diffuse and glossy surfaces reflect into a cosine weighted lobe around
+    // the normal or the mirror direction. The lobe is sampled exactly so the
+    // BSDF times the cosine equals the color times the density of the lobe.
+    bool diffuse = type == Shading::DIFF;
+    Color K = diffuse ? Kd : mat.Ks;
+    glm::vec3 axis = diffuse ? N : mirror(N, ray.D);
+    float spread = diffuse ? 1 : mat.Pr;
+
+    // Perfect mirrors can not reflect a direct light sample.
+    bool mis = config.rendering.mis && spread > 0;
+
+    // Directly sample a light for diffuse surfaces and with MIS also for
+    // glossy ones. The light is added once the shadow ray is found
+    // unoccluded. Both strategies are scaled by the Russian Roulette factor
+    // so they estimate the same light.
+    if (diffuse || mis) {
+      shadow = direct_light_sample(scene, O, N, axis, spread, sampler);
+      shadow.contribution = path.throughput * K * shadow.contribution * p;
+    }
+
+    glm::vec3 D = diffuse ? samplers::cos_weighted_hemi(N, sampler)
+                          : reflect(N, ray.D, mat.Pr, sampler);
+    path.throughput *= K * p;
+    path.ray = Ray(O, D);
+    path.emission = !diffuse || config.rendering.mis;
+
+    // Light samples behind the normal are thrown out so emission found in
+    // those directions is counted in full.
+    path.pdf = mis && glm::dot(N, D) >= 0
+                   ? samplers::var_cos_weighted_hemi_pdf(axis, spread, D)
+                   : 0;
+  } else {
+    glm::vec3 R = reflect(inter.N, ray.D, mat.Pr, sampler);
     float kr = fresnel(inter.N, ray.D, mat.Ni);
 
     // Probabilistically chose between reflection and refraction based on
     // fresnel factor.
-    if (fdist(gen) < kr) {
-      return mat.Ks * p * trace(scene, Ray(O, R), depth + 1, true);
+    if (fdist() < kr) {
+      path.throughput *= mat.Ks * p;
+      path.ray = Ray(O, R);
     } else {
       glm::vec3 O = P - config.rendering.epsilon * N;
       glm::vec3 T = refract(inter.N, ray.D, mat.Ni);
-      return mat.Kt * p * trace(scene, Ray(O, T), depth + 1, true);
+      path.throughput *= mat.Kt * p;
+      path.ray = Ray(O, T);
     }
+    path.emission = true;
+    path.pdf = 0;
   }
 
-  return Color::BLACK;
+  path.depth++;
+
+  // Nothing further along the path can add to the radiance.
+  return path.throughput.max() > 0;
+}
+
+glm::vec3 PathTracer::mirror(const glm::vec3& N, const glm::vec3& I) const {
+  return I - 2.0f * N * glm::dot(I, N);
 }
 
 glm::vec3 PathTracer::reflect(const glm::vec3& N, const glm::vec3& I,
-                              float roughness) const {
-  // Generate a perfect reflection direction. This will be used as the
-  // normal for the hemisphere sampling.
-  glm::vec3 D = I - 2.0f * N * glm::dot(I, N);
-  return samplers::var_cos_weighted_hemi(D, roughness, gen);
+                              float roughness, Sampler& sampler) const {
+  // The perfect reflection direction is used as the normal for the
+  // hemisphere sampling.
+  return samplers::var_cos_weighted_hemi(mirror(N, I), roughness, sampler);
 }
 
 /**
@@ -177,31 +245,43 @@ glm::vec3 PathTracer::refract(const glm::vec3& N, const glm::vec3& I,
   return glm::refract(I, N_, etai);
 }
 
-Color PathTracer::direct_light_sample(const Scene& scene, const glm::vec3& P,
-                                      const glm::vec3& N) const {
-  static std::uniform_int_distribution<int> idist(
-      0, std::numeric_limits<int>::max());
-
+PathTracer::Shadow PathTracer::direct_light_sample(
+    const Scene& scene, const glm::vec3& P, const glm::vec3& N,
+    const glm::vec3& axis, float spread, Sampler& sampler) const {
+  Shadow shadow;
   if (scene.lights.empty()) {
-    return Color::BLACK;
+    return shadow;
   }
 
-  int i = idist(gen) % scene.lights.size();
-  auto sample = scene.lights[i]->sample(P, gen);
+  int i = sampler.bounded(scene.lights.size());
+  auto sample = scene.lights[i]->sample(P, sampler);
   auto D = glm::normalize(sample.P - P);
-  float cos = glm::dot(N, D);
+  float light = sample.pdf / scene.lights.size();
+  float bsdf = samplers::var_cos_weighted_hemi_pdf(axis, spread, D);
 
-  // Throw this sample out if it is behind the normal.
-  if (cos < 0) {
-    return Color::BLACK;
+  // Throw this sample out if it is behind the normal or can not be reflected
+  // towards the camera.
+  if (glm::dot(N, D) < 0 || !(light > 0) || !(bsdf > 0)) {
+    return shadow;
   }
 
-  auto shadow = scene.bvh.intersect(Ray(P, D));
-  auto dist = glm::distance(sample.P, P);
+  float weight =
+      config.rendering.mis ? samplers::power_heuristic(light, bsdf) : 1;
 
-  if (!shadow || shadow.t + config.rendering.epsilon > dist) {
-    return sample.color * glm::dot(N, D) * scene.lights.size();
-  } else {
-    return Color::BLACK;
+  shadow.O = P;
+  shadow.D = D;
+  shadow.tmax = glm::distance(sample.P, P) - config.rendering.epsilon;
+  shadow.contribution = sample.color * (bsdf * weight / light);
+  return shadow;
+}
+
+float PathTracer::light_pdf(const Scene& scene, uint32_t triangle,
+                            const glm::vec3& P, const glm::vec3& X) const {
+  if (scene.lights.empty()) {
+    return 0;
   }
+
+  // Every emissive triangle is an area light and lights are chosen uniformly.
+  return AreaLight::pdf(scene.bvh.get_mesh(), triangle, P, X) /
+         scene.lights.size();
 }
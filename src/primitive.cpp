@@ -1,5 +0,0 @@
-#include "primitive.hpp"
-
-Primitive::Intersection::operator bool() const {
-  return t >= 0;
-}
@@ -1,6 +1,10 @@
 #include "ray.hpp"
 
-Ray::Ray(const glm::vec3& O, const glm::vec3& D) : O(O), D(glm::normalize(D)) {}
+Ray::Ray(const glm::vec3& O, const glm::vec3& D)
+    : O(O), D(glm::normalize(D)), invD(1.0f / this->D) {}
+
+Ray::Ray(const glm::vec3& O, const glm::vec3& D, const glm::vec3& invD)
+    : O(O), D(D), invD(invD) {}
 
 glm::vec3 Ray::at(float t) const {
   return O + D * t;
@@ -1,7 +1,12 @@
 #include "renderer.hpp"
+#include <algorithm>
 #include <chrono>
+#include <cstdint>
 #include <thread>
+#include <vector>
+#include "film.hpp"
 #include "image.hpp"
+#include "topology.hpp"
 #include "worker.hpp"
 
 std::shared_ptr<spdlog::logger> Renderer::LOG =
@@ -10,52 +15,119 @@ std::shared_ptr<spdlog::logger> Renderer::LOG =
 Renderer::Renderer(Config config, const ImageSaver& saver)
     : config(config), saver(saver) {}
 
+std::string Renderer::heatmap(const std::string& output) {
+  size_t dot = output.find_last_of('.');
+  size_t slash = output.find_last_of("/\\");
+
+  // Insert the suffix before the extension of the file name if it has one.
+  if (dot == std::string::npos || (slash != std::string::npos && dot < slash)) {
+    return output + "-samples";
+  }
+
+  return output.substr(0, dot) + "-samples" + output.substr(dot);
+}
+
 void Renderer::render(const Scene& scene, const std::string& output) const {
   int width = scene.camera.width;
   int height = scene.camera.height;
-  Image image(width, height);
-  image.set_gamma(2.2);
-
-  // Split up image into regions and shuffle for even load - some parts of the
-  // image may be more expensive than others.
-  Worker::Queue queue;
-  int total = width * height;
-  int partitionSize = total / config.job.partitions;
-  int partitions = 0;
-
-  for (int i = 0; i < total; i += partitionSize, partitions++) {
-    Worker::Work work{i, std::min(i + partitionSize, total), 0};
-    queue.push(work);
-  }
+  Film film(width, height);
+
+  // Split up image into tiles whose camera rays are more coherent than those
+  // of long strips. Threads take tiles in curve order so they render nearby
+  // parts of the scene.
+  auto work = Worker::tiles(width, height, config.job.tile, config.job.order);
+
+  // The budget only runs out early if adaptive sampling lets noisy tiles take
+  // more samples than the average.
+  int64_t budget = static_cast<int64_t>(width * height) *
+                   config.rendering.samples;
+  int limit = config.adaptive.threshold > 0 ? config.adaptive.max_samples
+                                            : config.rendering.samples;
+  Worker::Queue queue(std::move(work), config.job.threads,
+                      Worker::batch(config), budget, limit,
+                      Worker::strict(config));
 
   // Track the number of running workers.
   std::atomic<int> running(config.job.threads);
 
-  auto autosave = [&]() {
-    int progress = 0;
+  auto save = [&]() {
+    Image image = film.resolve();
+    image.set_gamma(2.2);
+    saver.save(output, image);
+
+    if (config.adaptive.heatmap) {
+      saver.save(heatmap(output), film.heatmap());
+    }
+  };
 
+  // A time limit stops the queue at the deadline. The threads then only
+  // finish the batch they are rendering so the image is saved soon after.
+  using Clock = std::chrono::steady_clock;
+  auto deadline = Clock::time_point::max();
+  if (config.job.time_limit > 0) {
+    deadline = Clock::now() + std::chrono::duration_cast<Clock::duration>(
+                                  std::chrono::duration<float>(
+                                      config.job.time_limit));
+  }
+
+  auto autosave = [&]() {
     while (running > 0) {
-      saver.save(output, image);
+      save();
+      LOG->info("{:d} samples...", queue.samples());
 
-      Worker::Work work;
-      if (queue.peek(work)) {
-        progress = work.samples;
-      }
+      auto next = Clock::now() + std::chrono::milliseconds(1000);
+      std::this_thread::sleep_until(std::min(next, deadline));
 
-      LOG->info("{:d} samples...", progress);
-      std::this_thread::sleep_for(std::chrono::milliseconds(1000));
+      if (Clock::now() >= deadline && running > 0) {
+        queue.stop();
+        LOG->info("Time limit reached after {:d} samples.", queue.samples());
+        break;
+      }
     }
   };
 
-  LOG->info("Rendering with {:d} threads...", config.job.threads);
+  // Pin the workers and give each NUMA node its own copy of the scene, made
+  // by a thread on that node so the copy lands in its memory.
+  Topology topology = Topology::detect();
+  std::vector<int> cpus = topology.place(config.job.threads,
+                                         config.job.affinity);
+
+  std::vector<Scene> replicas;
+  if (config.job.replicate && topology.nodes.size() > 1) {
+    replicas.resize(topology.nodes.size());
+
+    std::vector<std::thread> copiers;
+    for (size_t i = 0; i < topology.nodes.size(); i++) {
+      copiers.emplace_back([&, i]() {
+        Topology::pin(topology.nodes[i].front());
+        replicas[i] = scene.replicate();
+      });
+    }
+    std::for_each(copiers.begin(), copiers.end(),
+                  mem_fn(&std::thread::join));
+
+    LOG->info("Replicated the scene on {:d} NUMA nodes.", replicas.size());
+  }
+
+  LOG->info("Rendering with {:d} threads on {:d} CPUs in {:d} NUMA nodes...",
+            config.job.threads, topology.cpus(), topology.nodes.size());
 
   // Spawn workers + thread that periodically saves the image and logs progress.
   std::vector<std::thread> threads;
   threads.emplace_back(autosave);
   for (int i = 0; i < config.job.threads; i++) {
-    threads.emplace_back(Worker(config, scene, image, queue, running));
+    int cpu = cpus[i];
+    const Scene* local =
+        replicas.empty() ? &scene : &replicas[topology.node(cpu)];
+
+    threads.emplace_back([&, i, cpu, local]() {
+      if (cpu >= 0 && !Topology::pin(cpu)) {
+        LOG->warn("Could not pin thread {:d} to CPU {:d}.", i, cpu);
+      }
+      Worker(config, *local, film, queue, i, running)();
+    });
   }
 
   std::for_each(threads.begin(), threads.end(), mem_fn(&std::thread::join));
-  saver.save(output, image);
+  save();
 }
@@ -0,0 +1,21 @@
+#include "sampler.hpp"
+#include <algorithm>
+#include "halton-sampler.hpp"
+#include "independent-sampler.hpp"
+#include "sobol-sampler.hpp"
+
+uint32_t Sampler::bounded(uint32_t n) {
+  return std::min(static_cast<uint32_t>(next_1d() * n), n - 1);
+}
+
+std::unique_ptr<Sampler> Sampler::create(const Config& config) {
+  uint64_t seed = config.rendering.seed;
+
+  if (config.rendering.sampler == "halton") {
+    return std::unique_ptr<Sampler>(new HaltonSampler(seed));
+  } else if (config.rendering.sampler == "sobol") {
+    return std::unique_ptr<Sampler>(new SobolSampler(seed));
+  }
+
+  return std::unique_ptr<Sampler>(new IndependentSampler(seed));
+}
@@ -0,0 +1,31 @@
+#include "scene.hpp"
+#include <memory>
+#include <unordered_map>
+#include "image.hpp"
+#include "mesh.hpp"
+
+Scene Scene::replicate() const {
+  auto mesh = std::make_shared<Mesh>(bvh.get_mesh());
+
+  // Materials loaded from the same file share their texture, so copy each
+  // texture once and share the copy the same way.
+  std::unordered_map<const Image*, std::shared_ptr<Image>> textures;
+  for (Material& material : mesh->M) {
+    if (material.Kd_texture) {
+      auto& copy = textures[material.Kd_texture.get()];
+      if (!copy) {
+        copy = std::make_shared<Image>(*material.Kd_texture);
+      }
+      material.Kd_texture = copy;
+    }
+  }
+
+  Scene scene;
+  scene.camera = camera;
+  scene.bvh = bvh.replicate(mesh);
+  for (const auto& light : lights) {
+    scene.lights.push_back(light->replicate(mesh));
+  }
+
+  return scene;
+}
@@ -0,0 +1,65 @@
+#include "sobol-sampler.hpp"
+
+SobolSampler::SobolSampler(uint64_t seed) : seed(seed), sample(0) {}
+
+void SobolSampler::start(uint32_t pixel, uint32_t sample) {
+  this->sample = sample;
+  scramble = RNG::pixel(seed, pixel);
+}
+
+float SobolSampler::next_1d() {
+  return next_2d().x;
+}
+
+glm::vec2 SobolSampler::next_2d() {
+  // Draw every seed even for 1D dimensions so the dimensions of all samples
+  // of the pixel line up.
+  uint32_t shuffle = scramble();
+  uint32_t x_seed = scramble();
+  uint32_t y_seed = scramble();
+
+  uint32_t index = owen(sample, shuffle);
+  uint32_t x = owen(sobol(index, 0), x_seed);
+  uint32_t y = owen(sobol(index, 1), y_seed);
+
+  // The top 24 bits fill the mantissa exactly so 1 is never returned.
+  return glm::vec2((x >> 8) * (1.0f / 16777216.0f),
+                   (y >> 8) * (1.0f / 16777216.0f));
+}
+
+uint32_t SobolSampler::sobol(uint32_t index, int dimension) {
+  if (dimension == 0) {
+    return reverse(index);
+  }
+
+  // The direction numbers of the second dimension are the rows of Pascal's
+  // triangle modulo 2.
+  uint32_t result = 0;
+  for (uint32_t v = 1u << 31; index > 0; index >>= 1, v ^= v >> 1) {
+    if (index & 1) {
+      result ^= v;
+    }
+  }
+
+  return result;
+}
+
+uint32_t SobolSampler::owen(uint32_t x, uint32_t seed) {
+  // Laine-Karras hash of the reversed bits so each bit only depends on the
+  // more significant bits of x.
+  x = reverse(x);
+  x += seed;
+  x ^= x * 0x6c50b47c;
+  x ^= x * 0xb82f1e52;
+  x ^= x * 0xc7afe638;
+  x ^= x * 0x8d22f6e6;
+  return reverse(x);
+}
+
+uint32_t SobolSampler::reverse(uint32_t x) {
+  x = ((x >> 1) & 0x55555555) | ((x & 0x55555555) << 1);
+  x = ((x >> 2) & 0x33333333) | ((x & 0x33333333) << 2);
+  x = ((x >> 4) & 0x0F0F0F0F) | ((x & 0x0F0F0F0F) << 4);
+  x = ((x >> 8) & 0x00FF00FF) | ((x & 0x00FF00FF) << 8);
+  return (x >> 16) | (x << 16);
+}
@@ -0,0 +1,157 @@
+#include "topology.hpp"
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <utility>
+
+#if defined(__linux__)
+#include <sched.h>
+#define TOPOLOGY_SCHED
+#endif
+
+Topology::Topology(std::vector<std::vector<int>> nodes)
+    : nodes(std::move(nodes)) {}
+
+Topology Topology::detect() {
+  std::vector<int> allowed;
+
+#ifdef TOPOLOGY_SCHED
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+      if (CPU_ISSET(cpu, &set)) {
+        allowed.push_back(cpu);
+      }
+    }
+  }
+#endif
+
+  if (allowed.empty()) {
+    int count = std::max(1u, std::thread::hardware_concurrency());
+    for (int cpu = 0; cpu < count; cpu++) {
+      allowed.push_back(cpu);
+    }
+  }
+
+  // Keep the allowed CPUs of each node. Node ids may have gaps so stop only
+  // after a run of missing nodes.
+  std::vector<std::vector<int>> nodes;
+  for (int id = 0, missing = 0; missing < 64; id++) {
+    std::ifstream file("/sys/devices/system/node/node" + std::to_string(id) +
+                       "/cpulist");
+    if (!file) {
+      missing++;
+      continue;
+    }
+    missing = 0;
+
+    std::string list;
+    std::getline(file, list);
+
+    std::vector<int> cpus;
+    for (int cpu : parse(list)) {
+      if (std::binary_search(allowed.begin(), allowed.end(), cpu)) {
+        cpus.push_back(cpu);
+      }
+    }
+
+    if (!cpus.empty()) {
+      nodes.push_back(std::move(cpus));
+    }
+  }
+
+  if (nodes.empty()) {
+    nodes.push_back(allowed);
+  }
+
+  return Topology(std::move(nodes));
+}
+
+int Topology::cpus() const {
+  int count = 0;
+  for (const auto& node : nodes) {
+    count += node.size();
+  }
+  return count;
+}
+
+int Topology::node(int cpu) const {
+  for (size_t i = 0; i < nodes.size(); i++) {
+    if (std::find(nodes[i].begin(), nodes[i].end(), cpu) != nodes[i].end()) {
+      return i;
+    }
+  }
+  return 0;
+}
+
+std::vector<int> Topology::place(int threads,
+                                 const std::string& affinity) const {
+  std::vector<int> placement(threads, -1);
+  if (affinity == "compact") {
+    std::vector<int> order;
+    for (const auto& node : nodes) {
+      order.insert(order.end(), node.begin(), node.end());
+    }
+
+    for (int i = 0; i < threads; i++) {
+      placement[i] = order[i % order.size()];
+    }
+  } else if (affinity == "scatter") {
+    // Take the next CPU of every node in turn, skipping nodes that ran out.
+    std::vector<int> order;
+    for (size_t round = 0; order.size() < static_cast<size_t>(cpus());
+         round++) {
+      for (const auto& node : nodes) {
+        if (round < node.size()) {
+          order.push_back(node[round]);
+        }
+      }
+    }
+
+    for (int i = 0; i < threads; i++) {
+      placement[i] = order[i % order.size()];
+    }
+  }
+
+  return placement;
+}
+
+bool Topology::pin(int cpu) {
+#ifdef TOPOLOGY_SCHED
+  if (cpu < 0 || cpu >= CPU_SETSIZE) {
+    return false;
+  }
+
+  // On Linux a pid of 0 sets the affinity of the calling thread only.
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(cpu, &set);
+  return sched_setaffinity(0, sizeof(set), &set) == 0;
+#else
+  return false;
+#endif
+}
+
+std::vector<int> Topology::parse(const std::string& list) {
+  std::vector<int> cpus;
+  std::stringstream stream(list);
+  std::string range;
+
+  while (std::getline(stream, range, ',')) {
+    if (range.empty()) {
+      continue;
+    }
+
+    size_t dash = range.find('-');
+    int first = std::stoi(range.substr(0, dash));
+    int last = dash == std::string::npos ? first
+                                         : std::stoi(range.substr(dash + 1));
+    for (int cpu = first; cpu <= last; cpu++) {
+      cpus.push_back(cpu);
+    }
+  }
+
+  return cpus;
+}
@@ -0,0 +1,220 @@
+#include "wavefront.hpp"
+#include <algorithm>
+#include <utility>
+
+Wavefront::Wavefront(Config config)
+    : config(config), pathtracer(std::move(config)) {}
+
+void Wavefront::render(const Scene& scene, glm::ivec2 begin, glm::ivec2 end,
+                       uint32_t first, int batch, Film& film) {
+  generate(scene, begin, end, first, batch);
+
+  // Camera rays of a tile are coherent already so only later bounces are
+  // sorted.
+  for (int bounce = 0; !active.empty(); bounce++) {
+    if (config.rendering.sort && bounce > 0) {
+      sort_rays(scene);
+    }
+    intersect(scene, bounce == 0);
+
+    if (config.rendering.sort) {
+      sort_hits(scene);
+    }
+    shade(scene);
+    shadow(scene);
+
+    std::swap(active, next);
+  }
+
+  // The samples of a pixel are consecutive paths.
+  uint32_t path = 0;
+  for (int y = begin.y; y < end.y; y++) {
+    for (int x = begin.x; x < end.x; x++) {
+      Color sum;
+      double squared = 0;
+      for (int i = 0; i < batch; i++, path++) {
+        const Color& color = radiance[path];
+        double intensity = (color.r + color.g + color.b) / 3.0;
+
+        sum += color;
+        squared += intensity * intensity;
+      }
+
+      film.add(x, y, sum, squared, batch);
+    }
+  }
+}
+
+Ray Wavefront::ray(uint32_t path) const {
+  return Ray(O[path], D[path], invD[path]);
+}
+
+void Wavefront::generate(const Scene& scene, glm::ivec2 begin, glm::ivec2 end,
+                         uint32_t first, int batch) {
+  glm::ivec2 extent = end - begin;
+  size_t paths = static_cast<size_t>(extent.x * extent.y) * batch;
+
+  // The buffers only grow so their memory is reused by later tiles.
+  while (samplers.size() < paths) {
+    samplers.push_back(Sampler::create(config));
+  }
+
+  O.resize(paths);
+  D.resize(paths);
+  invD.resize(paths);
+  t.resize(paths);
+  N.resize(paths);
+  uv.resize(paths);
+  triangle.resize(paths);
+  throughput.resize(paths);
+  radiance.resize(paths);
+  depth.resize(paths);
+  emission.resize(paths);
+  pdf.resize(paths);
+  active.clear();
+
+  uint32_t path = 0;
+  for (int y = begin.y; y < end.y; y++) {
+    for (int x = begin.x; x < end.x; x++) {
+      uint32_t pixel = y * scene.camera.width + x;
+
+      for (int i = 0; i < batch; i++, path++) {
+        Sampler& sampler = *samplers[path];
+        sampler.start(pixel, first + i);
+
+        PathTracer::Path start =
+            pathtracer.start(scene.camera.pixel_ray(x, y, sampler));
+        O[path] = start.ray.O;
+        D[path] = start.ray.D;
+        invD[path] = start.ray.invD;
+        throughput[path] = start.throughput;
+        radiance[path] = start.radiance;
+        depth[path] = start.depth;
+        emission[path] = start.emission;
+        pdf[path] = start.pdf;
+        active.push_back(path);
+      }
+    }
+  }
+}
+
+void Wavefront::sort_rays(const Scene& scene) {
+  BoundingBox bounds = scene.bvh.get_bounds();
+  glm::vec3 extent = bounds.max - bounds.min;
+  glm::vec3 scale;
+  for (int axis = 0; axis < 3; axis++) {
+    scale[axis] = extent[axis] > 0 ? BVH::MORTON_GRID / extent[axis] : 0;
+  }
+
+  keys.clear();
+  for (uint32_t path : active) {
+    const glm::vec3& d = D[path];
+    uint64_t octant = (d.x < 0) | ((d.y < 0) << 1) | ((d.z < 0) << 2);
+    uint32_t code = BVH::morton((O[path] - bounds.min) * scale);
+    keys.emplace_back((octant << BVH::MORTON_BITS) | code, path);
+  }
+
+  std::sort(keys.begin(), keys.end());
+  for (size_t i = 0; i < keys.size(); i++) {
+    active[i] = keys[i].second;
+  }
+}
+
+void Wavefront::sort_hits(const Scene& scene) {
+  keys.clear();
+  for (size_t i = 0; i < active.size(); i++) {
+    // Only hits read the mesh, which an empty tree does not have.
+    uint32_t path = active[i];
+    uint64_t material = t[path] >= 0
+                            ? scene.bvh.get_mesh().materials[triangle[path]]
+                            : UINT32_MAX;
+    keys.emplace_back((material << 32) | i, path);
+  }
+
+  std::sort(keys.begin(), keys.end());
+  for (size_t i = 0; i < keys.size(); i++) {
+    active[i] = keys[i].second;
+  }
+}
+
+void Wavefront::intersect(const Scene& scene, bool primary) {
+  // Camera rays of neighbouring samples are traced together as packets.
+  size_t size = primary ? BVH::PACKET_SIZE : 1;
+
+  BVH::Intersection inters[BVH::PACKET_SIZE];
+
+  for (size_t begin = 0; begin < active.size(); begin += size) {
+    size_t end = std::min(begin + size, active.size());
+
+    rays.clear();
+    for (size_t i = begin; i < end; i++) {
+      rays.push_back(ray(active[i]));
+    }
+
+    if (primary) {
+      scene.bvh.intersect_packet(rays.data(), rays.size(), inters);
+    } else {
+      inters[0] = scene.bvh.intersect(rays[0]);
+    }
+
+    for (size_t i = begin; i < end; i++) {
+      const BVH::Intersection& inter = inters[i - begin];
+      uint32_t path = active[i];
+      t[path] = inter.t;
+      N[path] = inter.N;
+      uv[path] = inter.uv;
+      triangle[path] = inter.triangle;
+    }
+  }
+}
+
+void Wavefront::shade(const Scene& scene) {
+  next.clear();
+  shadow_O.clear();
+  shadow_D.clear();
+  shadow_tmax.clear();
+  shadow_contribution.clear();
+  shadow_path.clear();
+
+  for (uint32_t path : active) {
+    BVH::Intersection inter;
+    inter.t = t[path];
+    inter.N = N[path];
+    inter.uv = uv[path];
+    inter.triangle = triangle[path];
+
+    PathTracer::Path state{ray(path), throughput[path], radiance[path],
+                           depth[path], emission[path] != 0, pdf[path]};
+    PathTracer::Shadow light;
+    bool alive = pathtracer.shade(scene, inter, state, light, *samplers[path]);
+
+    O[path] = state.ray.O;
+    D[path] = state.ray.D;
+    invD[path] = state.ray.invD;
+    throughput[path] = state.throughput;
+    radiance[path] = state.radiance;
+    depth[path] = state.depth;
+    emission[path] = state.emission;
+    pdf[path] = state.pdf;
+
+    if (light.tmax > 0) {
+      shadow_O.push_back(light.O);
+      shadow_D.push_back(light.D);
+      shadow_tmax.push_back(light.tmax);
+      shadow_contribution.push_back(light.contribution);
+      shadow_path.push_back(path);
+    }
+
+    if (alive) {
+      next.push_back(path);
+    }
+  }
+}
+
+void Wavefront::shadow(const Scene& scene) {
+  for (size_t i = 0; i < shadow_path.size(); i++) {
+    if (!scene.bvh.occluded(Ray(shadow_O[i], shadow_D[i]), shadow_tmax[i])) {
+      radiance[shadow_path[i]] += shadow_contribution[i];
+    }
+  }
+}
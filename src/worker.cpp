@@ -1,14 +1,10 @@
 #include "worker.hpp"
-
-/**
- * ============================================================
- *                             WORK
- * ============================================================
- */
-
-bool Worker::Work::operator>(const Worker::Work& other) const {
-  return samples > other.samples;
-}
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <utility>
+#include "wavefront.hpp"
 
 /**
  * ============================================================
@@ -16,66 +12,321 @@ bool Worker::Work::operator>(const Worker::Work& other) const {
  * ============================================================
  */
 
-Worker::Worker(Config config, const Scene& scene, Image& image,
-               Worker::Queue& queue, std::atomic<int>& running)
+Worker::Worker(Config config, const Scene& scene, Film& film,
+               Worker::Queue& queue, int thread, std::atomic<int>& running)
     : pathtracer(config),
       config(config),
       scene(scene),
-      image(image),
+      film(film),
       queue(queue),
+      thread(thread),
       running(running) {}
 
 void Worker::operator()() const {
-  Work work;
+  auto sampler = Sampler::create(config);
+  Work* work;
+
+  // The wavefront integrator keeps its buffers for the following tiles.
+  std::unique_ptr<Wavefront> wavefront;
+  if (config.rendering.integrator == "wavefront") {
+    wavefront.reset(new Wavefront(config));
+  }
 
-  while (queue.poll(work)) {
-    for (int i = work.begin; i < work.end; i++) {
-      int x = i % scene.camera.width;
-      int y = i / scene.camera.width;
+  // Adaptive rendering lets noisy tiles take more than the average samples.
+  bool adaptive = config.adaptive.threshold > 0;
+  int limit = adaptive ? config.adaptive.max_samples : config.rendering.samples;
 
-      Ray ray = scene.camera.pixel_ray(x, y);
-      Color pixel = pathtracer.trace(scene, ray);
-      float factor = static_cast<float>(work.samples) / (work.samples + 1);
+  while ((work = queue.poll(thread)) != nullptr) {
+    // Take a batch of samples per pixel and add them to the film at once.
+    int batch = std::min(Worker::batch(config), limit - work->samples);
 
-      Color current = image.get_pixel(x, y);
-      image.set_pixel(x, y, current * factor + pixel * (1 - factor));
+    // Stop once the samples of the converged tiles are handed out.
+    if (!queue.granted(work)) {
+      queue.finish();
+      continue;
     }
 
-    work.samples++;
-    if (work.samples < config.rendering.samples) {
-      queue.push(work);
+    if (wavefront) {
+      wavefront->render(scene, work->begin, work->end, work->samples, batch,
+                        film);
+    } else {
+      for (int y = work->begin.y; y < work->end.y; y++) {
+        for (int x = work->begin.x; x < work->end.x; x++) {
+          uint32_t pixel = y * scene.camera.width + x;
+
+          Color sum;
+          double squared = 0;
+          for (int i = 0; i < batch; i++) {
+            // Derive the random numbers from the sample rather than the thread
+            // so renders are reproducible.
+            sampler->start(pixel, work->samples + i);
+
+            Ray ray = scene.camera.pixel_ray(x, y, *sampler);
+            Color color = pathtracer.trace(scene, ray, *sampler);
+            double intensity = (color.r + color.g + color.b) / 3.0;
+
+            sum += color;
+            squared += intensity * intensity;
+          }
+
+          film.add(x, y, sum, squared, batch);
+        }
+      }
+    }
+
+    work->samples += batch;
+    if (work->samples < limit && !(adaptive && converged(*work))) {
+      queue.push(thread, work);
+    } else {
+      queue.finish();
     }
   }
 
   running--;
 }
 
+bool Worker::converged(const Work& work) const {
+  if (work.samples < config.adaptive.min_samples) {
+    return false;
+  }
+
+  for (int y = work.begin.y; y < work.end.y; y++) {
+    for (int x = work.begin.x; x < work.end.x; x++) {
+      if (film.error(x, y) >= config.adaptive.threshold) {
+        return false;
+      }
+    }
+  }
+
+  return true;
+}
+
+int Worker::batch(const Config& config) {
+  return config.job.time_limit > 0 ? 1 : config.job.batch;
+}
+
+bool Worker::strict(const Config& config) {
+  return config.job.time_limit > 0 || config.adaptive.threshold > 0;
+}
+
+std::vector<Worker::Work> Worker::tiles(int width, int height, int size,
+                                        const std::string& order) {
+  int columns = (width + size - 1) / size;
+  int rows = (height + size - 1) / size;
+
+  // The curves fill a square power of two grid which covers the tiles.
+  uint32_t side = 1;
+  while (side < static_cast<uint32_t>(std::max(columns, rows))) {
+    side *= 2;
+  }
+
+  std::vector<std::pair<uint32_t, Work>> keyed;
+  for (int row = 0; row < rows; row++) {
+    for (int column = 0; column < columns; column++) {
+      glm::ivec2 begin(column * size, row * size);
+      glm::ivec2 end(std::min(begin.x + size, width),
+                     std::min(begin.y + size, height));
+
+      uint32_t key = row * columns + column;
+      if (order == "morton") {
+        key = morton(column, row);
+      } else if (order == "hilbert") {
+        key = hilbert(side, column, row);
+      }
+
+      keyed.emplace_back(key, Work{begin, end, 0});
+    }
+  }
+
+  std::sort(keyed.begin(), keyed.end(),
+            [](const std::pair<uint32_t, Work>& a,
+               const std::pair<uint32_t, Work>& b) {
+              return a.first < b.first;
+            });
+
+  std::vector<Work> work;
+  for (const auto& tile : keyed) {
+    work.push_back(tile.second);
+  }
+
+  return work;
+}
+
+uint32_t Worker::morton(uint32_t x, uint32_t y) {
+  // Spread the lower 16 bits of each coordinate to every other bit.
+  auto spread = [](uint32_t v) {
+    v &= 0x0000FFFF;
+    v = (v | (v << 8)) & 0x00FF00FF;
+    v = (v | (v << 4)) & 0x0F0F0F0F;
+    v = (v | (v << 2)) & 0x33333333;
+    v = (v | (v << 1)) & 0x55555555;
+    return v;
+  };
+
+  return spread(x) | (spread(y) << 1);
+}
+
+uint32_t Worker::hilbert(uint32_t n, uint32_t x, uint32_t y) {
+  // See https://en.wikipedia.org/wiki/Hilbert_curve
+  uint32_t d = 0;
+  for (uint32_t s = n / 2; s > 0; s /= 2) {
+    uint32_t rx = (x & s) > 0;
+    uint32_t ry = (y & s) > 0;
+    d += s * s * ((3 * rx) ^ ry);
+
+    // Rotate the quadrant so the curve continues where it left off.
+    if (ry == 0) {
+      if (rx == 1) {
+        x = n - 1 - x;
+        y = n - 1 - y;
+      }
+      std::swap(x, y);
+    }
+  }
+
+  return d;
+}
+
 /**
  * ============================================================
  *                            QUEUE
  * ============================================================
  */
 
-void Worker::Queue::push(const Work& work) {
-  std::lock_guard<std::mutex> lock(mutex);
-  queue.push(work);
+Worker::Queue::Queue(std::vector<Work> work, int threads, int batch,
+                     int64_t budget, int limit, bool strict)
+    : work(std::move(work)),
+      threads(threads),
+      batch(batch),
+      limit(limit),
+      strict(strict),
+      pass(0),
+      allocated(0),
+      pending(0),
+      stopped(false),
+      budget(budget),
+      passes(this->work.size(), 0),
+      grants(this->work.size(), 0) {
+  unfinished[0] = 0;
+  unfinished[1] = 0;
+
+  for (int i = 0; i < 2 * threads; i++) {
+    deques.emplace_back(new Deque(this->work.size()));
+  }
+
+  // Deal the work out to the threads for the first pass.
+  for (size_t i = 0; i < this->work.size(); i++) {
+    deque(i % threads, 0).push(i);
+  }
+
+  unfinished[0] = this->work.size();
+  pending = this->work.size();
+  allocate(0);
 }
 
-bool Worker::Queue::poll(Work& work) {
-  std::lock_guard<std::mutex> lock(mutex);
+Worker::Work* Worker::Queue::poll(int thread) {
+  while (pending > 0 && !stopped) {
+    int current = pass.load();
+    int parity = current & 1;
+    int index;
 
-  if (queue.empty()) return false;
+    // Prefer local work and steal from the other threads once it runs out.
+    bool found = deque(thread, parity).pop(index);
+    for (int i = 1; i < threads && !found; i++) {
+      found = deque((thread + i) % threads, parity).steal(index);
+    }
 
-  work = std::move(queue.top());
-  queue.pop();
-  return true;
+    // Work taken after the pass advanced belongs to the pass after the next,
+    // so hand it back until that pass starts.
+    if (found && pass.load() != current) {
+      deque(thread, parity).push(index);
+      continue;
+    }
+
+    if (found) {
+      // Strict queues count the work until it is pushed or finished.
+      if (!strict) {
+        unfinished[parity]--;
+      }
+      return &work[index];
+    }
+
+    // Start the next pass once the current one is drained, or for a strict
+    // queue once all its work is finished. Otherwise wait for the work other
+    // threads are rendering. The thread which claims the next pass of a
+    // strict queue grants its budget before it starts.
+    int expected = current;
+    if (unfinished[parity] == 0 && unfinished[parity ^ 1] > 0 &&
+        allocated.compare_exchange_strong(expected, current + 1)) {
+      if (strict) {
+        allocate(current + 1);
+      }
+      pass = current + 1;
+    } else {
+      std::this_thread::yield();
+    }
+  }
+
+  return nullptr;
 }
 
-bool Worker::Queue::peek(Work& work) {
-  std::lock_guard<std::mutex> lock(mutex);
+void Worker::Queue::push(int thread, Work* work) {
+  // Work which fell behind joins the current pass.
+  if (!strict) {
+    int parity = std::max(work->samples / batch, pass.load()) & 1;
+    unfinished[parity]++;
+    deque(thread, parity).push(work - this->work.data());
+    return;
+  }
 
-  if (queue.empty()) return false;
+  // The pass cannot advance while the work is being rendered. Count the work
+  // for the next pass before it leaves the current one so the next pass never
+  // looks empty.
+  int current = pass.load();
+  int index = work - this->work.data();
+  passes[index] = current + 1;
+  unfinished[(current + 1) & 1]++;
+  deque(thread, (current + 1) & 1).push(index);
+  unfinished[current & 1]--;
+}
 
-  work = queue.top();
-  return true;
+void Worker::Queue::finish() {
+  if (strict) {
+    unfinished[pass.load() & 1]--;
+  }
+  pending--;
+}
+
+void Worker::Queue::stop() {
+  stopped = true;
+}
+
+bool Worker::Queue::granted(const Work* work) const {
+  return !strict || grants[work - this->work.data()];
+}
+
+void Worker::Queue::allocate(int pass) {
+  for (size_t i = 0; i < work.size(); i++) {
+    if (passes[i] != pass) {
+      continue;
+    }
+
+    glm::ivec2 extent = work[i].end - work[i].begin;
+    int64_t samples = static_cast<int64_t>(extent.x * extent.y) *
+                      std::min(batch, limit - work[i].samples);
+
+    // Only take what is left so smaller tiles may still use the rest.
+    grants[i] = samples <= budget;
+    if (grants[i]) {
+      budget -= samples;
+    }
+  }
+}
+
+int Worker::Queue::samples() const {
+  return pass * batch;
+}
+
+Deque& Worker::Queue::deque(int thread, int parity) {
+  return *deques[2 * thread + parity];
 }
@@ -0,0 +1,213 @@
+#include <catch.hpp>
+#include <cstdio>
+#include <fstream>
+#include <glm/glm.hpp>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "bvh.hpp"
+#include "cache.hpp"
+#include "config.hpp"
+#include "mesh.hpp"
+#include "ray.hpp"
+#include "test-scene.hpp"
+
+TEST_CASE("BVH intersection matches brute force", "[bvh]") {
+  std::mt19937 gen(42);
+  std::uniform_real_distribution<float> dist(-1, 1);
+
+  auto mesh = std::make_shared<Mesh>();
+  mesh->M.push_back(Material());
+
+  // Scatter small triangles around the unit cube.
+  for (int i = 0; i < 500; i++) {
+    glm::vec3 C(dist(gen), dist(gen), dist(gen));
+    int v = mesh->V.size();
+    mesh->V.push_back(C + 0.1f * glm::vec3(dist(gen), dist(gen), dist(gen)));
+    mesh->V.push_back(C + 0.1f * glm::vec3(dist(gen), dist(gen), dist(gen)));
+    mesh->V.push_back(C + 0.1f * glm::vec3(dist(gen), dist(gen), dist(gen)));
+
+    Vertex a{v, -1, -1};
+    Vertex b{v + 1, -1, -1};
+    Vertex c{v + 2, -1, -1};
+    mesh->add(a, b, c, 0);
+  }
+
+  Config config;
+  config.bvh.width = 2;
+  config.bvh.leaf_size = 4;
+  config.bvh.max_depth = 64;
+  config.bvh.bins = 16;
+  config.bvh.watertight = false;
+
+  auto check = [&](const BVH& bvh) {
+    for (int i = 0; i < 1000; i++) {
+      Ray ray(glm::vec3(dist(gen), dist(gen), dist(gen)) * 2.0f,
+              glm::vec3(dist(gen), dist(gen), dist(gen)));
+
+      Mesh::Intersection closest;
+      for (uint32_t id = 0; id < mesh->size(); id++) {
+        auto inter = mesh->intersects(id, ray);
+        if (inter && (!closest || inter.t < closest.t)) {
+          closest = inter;
+        }
+      }
+
+      auto inter = bvh.intersect(ray);
+      REQUIRE(static_cast<bool>(inter) == static_cast<bool>(closest));
+      if (closest) {
+        REQUIRE(inter.t == Approx(closest.t));
+      }
+
+      // Occlusion is only reported for hits strictly closer than tmax.
+      float tmax = closest ? closest.t : 10.0f;
+      REQUIRE(bvh.occluded(ray, tmax + 0.001f) == static_cast<bool>(closest));
+      REQUIRE(!bvh.occluded(ray, tmax - 0.001f));
+    }
+
+    // Packets of rays from a shared origin through a small patch like camera
+    // rays, and packets of unrelated rays which take the fallback.
+    for (int i = 0; i < 200; i++) {
+      glm::vec3 O = glm::vec3(dist(gen), dist(gen), dist(gen)) * 2.0f;
+      glm::vec3 D(dist(gen), dist(gen), dist(gen));
+      float spread = i % 2 == 0 ? 0.05f : 2.0f;
+
+      std::vector<Ray> rays;
+      for (int j = 0; j < BVH::PACKET_SIZE; j++) {
+        glm::vec3 jitter(dist(gen), dist(gen), dist(gen));
+        rays.emplace_back(O, D + spread * jitter);
+      }
+
+      BVH::Intersection packet[BVH::PACKET_SIZE];
+      bvh.intersect_packet(rays.data(), rays.size(), packet);
+
+      for (size_t j = 0; j < rays.size(); j++) {
+        auto single = bvh.intersect(rays[j]);
+        REQUIRE(static_cast<bool>(packet[j]) == static_cast<bool>(single));
+        if (single) {
+          REQUIRE(packet[j].t == single.t);
+          REQUIRE(packet[j].triangle == single.triangle);
+        }
+      }
+    }
+  };
+
+  SECTION("midpoint builder") {
+    config.bvh.builder = "midpoint";
+    check(BVH::build(mesh, config));
+  }
+
+  SECTION("sah builder") {
+    config.bvh.builder = "sah";
+    check(BVH::build(mesh, config));
+  }
+
+  SECTION("lbvh builder") {
+    config.bvh.builder = "lbvh";
+    check(BVH::build(mesh, config));
+  }
+
+  SECTION("4-wide sah builder") {
+    config.bvh.builder = "sah";
+    config.bvh.width = 4;
+    check(BVH::build(mesh, config));
+  }
+
+  SECTION("watertight 4-wide sah builder") {
+    config.bvh.builder = "sah";
+    config.bvh.width = 4;
+    config.bvh.watertight = true;
+    check(BVH::build(mesh, config));
+  }
+
+  SECTION("8-wide midpoint builder") {
+    config.bvh.builder = "midpoint";
+    config.bvh.width = 8;
+    check(BVH::build(mesh, config));
+  }
+}
+
+TEST_CASE("Parallel BVH build matches serial build", "[bvh]") {
+  std::mt19937 gen(7);
+  std::uniform_real_distribution<float> dist(-1, 1);
+
+  auto mesh = std::make_shared<Mesh>();
+  mesh->M.push_back(Material());
+
+  // Enough triangles for the top levels to be built in parallel.
+  for (int i = 0; i < 50000; i++) {
+    glm::vec3 C(dist(gen), dist(gen), dist(gen));
+    int v = mesh->V.size();
+    mesh->V.push_back(C + 0.01f * glm::vec3(dist(gen), dist(gen), dist(gen)));
+    mesh->V.push_back(C + 0.01f * glm::vec3(dist(gen), dist(gen), dist(gen)));
+    mesh->V.push_back(C + 0.01f * glm::vec3(dist(gen), dist(gen), dist(gen)));
+
+    Vertex a{v, -1, -1};
+    Vertex b{v + 1, -1, -1};
+    Vertex c{v + 2, -1, -1};
+    mesh->add(a, b, c, 0);
+  }
+
+  Config config;
+  config.bvh.leaf_size = 4;
+  config.bvh.max_depth = 64;
+  config.bvh.bins = 16;
+  config.bvh.watertight = false;
+
+  const std::string directory = temp_directory("bvh_tests");
+
+  // Returns the bytes of the tree as written to the scene cache.
+  auto serialize = [&](const BVH& bvh, const std::string& name) {
+    std::string path = directory + "/" + name;
+    {
+      cache::Writer writer(path);
+      bvh.write(writer);
+      writer.commit();
+    }
+
+    std::ifstream in(path, std::ios::binary);
+    std::ostringstream bytes;
+    bytes << in.rdbuf();
+    std::remove(path.c_str());
+    return bytes.str();
+  };
+
+  // The nodes, their bounds and the triangle order must all be the same, also
+  // once collapsed into wide nodes.
+  auto check = [&]() {
+    for (int width : {2, 4}) {
+      config.bvh.width = width;
+
+      config.job.threads = 1;
+      std::string serial = serialize(BVH::build(mesh, config), "serial.bvh");
+
+      config.job.threads = 4;
+      std::string parallel =
+          serialize(BVH::build(mesh, config), "parallel.bvh");
+
+      REQUIRE(!serial.empty());
+      REQUIRE(parallel.size() == serial.size());
+      bool identical = parallel == serial;
+      REQUIRE(identical);
+    }
+  };
+
+  SECTION("midpoint builder") {
+    config.bvh.builder = "midpoint";
+    check();
+  }
+
+  SECTION("sah builder") {
+    config.bvh.builder = "sah";
+    check();
+  }
+
+  SECTION("lbvh builder") {
+    config.bvh.builder = "lbvh";
+    check();
+  }
+
+  remove_directory(directory);
+}
@@ -1,10 +1,13 @@
 #include "camera.hpp"
 #include "catch.hpp"
 #include "glm/glm.hpp"
+#include "independent-sampler.hpp"
 
 TEST_CASE("Ray is correct", "[pixel_ray]") {
   constexpr float EPS = 0.15;
 
+  IndependentSampler sampler(1);
+  sampler.start(0, 0);
   Camera camera;
   camera.P = glm::vec3(1, 2, 3);
   camera.U = glm::vec3(1, 0, 0);
@@ -15,7 +18,7 @@ TEST_CASE("Ray is correct", "[pixel_ray]") {
   camera.height = 5;
 
   SECTION("ray through center is correct") {
-    Ray ray = camera.pixel_ray(2, 2);
+    Ray ray = camera.pixel_ray(2, 2, sampler);
     REQUIRE(ray.O == camera.P);
     REQUIRE(ray.D.x == Approx(0).epsilon(EPS));
     REQUIRE(ray.D.y == Approx(0).epsilon(EPS));
@@ -23,7 +26,7 @@ TEST_CASE("Ray is correct", "[pixel_ray]") {
   }
 
   SECTION("ray through top left is correct") {
-    Ray ray = camera.pixel_ray(0, 0);
+    Ray ray = camera.pixel_ray(0, 0, sampler);
 
     float d = glm::sqrt(2 * 2 + 2 * 2 + 2.5 * 2.5);
     REQUIRE(ray.O == camera.P);
@@ -33,7 +36,7 @@ TEST_CASE("Ray is correct", "[pixel_ray]") {
   }
 
   SECTION("ray through bottom right is correct") {
-    Ray ray = camera.pixel_ray(4, 4);
+    Ray ray = camera.pixel_ray(4, 4, sampler);
 
     float d = glm::sqrt(2 * 2 + 2 * 2 + 2.5 * 2.5);
     REQUIRE(ray.O == camera.P);
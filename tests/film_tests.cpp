@@ -0,0 +1,64 @@
+#include <catch.hpp>
+#include <atomic>
+#include <thread>
+#include "color.hpp"
+#include "film.hpp"
+#include "image.hpp"
+
+TEST_CASE("Film averages the samples of each pixel", "[film]") {
+  Film film(2, 1);
+
+  film.add(0, 0, Color(1, 2, 3), 8, 2);
+  film.add(0, 0, Color(2, 1, 0), 1, 1);
+  REQUIRE(film.samples(0, 0) == 3);
+  REQUIRE(film.samples(1, 0) == 0);
+
+  Image image = film.resolve();
+  Color pixel = image.get_pixel(0, 0);
+  REQUIRE(pixel.r == Approx(1));
+  REQUIRE(pixel.g == Approx(1));
+  REQUIRE(pixel.b == Approx(1));
+  REQUIRE(pixel.a == Approx(1));
+
+  // Pixels without samples stay transparent.
+  REQUIRE(image.get_pixel(1, 0).a == 0);
+
+  SECTION("error is the relative standard error of the mean") {
+    // Mean intensity 1 with a sample variance of (9 / 3 - 1) * 3 / 2 = 3.
+    REQUIRE(film.error(0, 0) == Approx(1));
+
+    film.add(1, 0, Color(0.5f, 0.5f, 0.5f), 0.25, 1);
+    REQUIRE(film.error(1, 0) > 1000);
+
+    film.add(1, 0, Color(0.5f, 0.5f, 0.5f), 0.25, 1);
+    REQUIRE(film.error(1, 0) == Approx(0).margin(1e-6));
+
+    Image heatmap = film.heatmap();
+    REQUIRE(heatmap.get_pixel(0, 0).r == Approx(1));
+    REQUIRE(heatmap.get_pixel(1, 0).r == Approx(2.0f / 3));
+  }
+
+  SECTION("resolving while samples are added sees whole samples") {
+    std::atomic<bool> done(false);
+
+    // Every sample is white so any torn read resolves to another color.
+    std::thread writer([&]() {
+      for (int i = 0; i < 100000; i++) {
+        film.add(1, 0, Color(1, 1, 1), 1, 1);
+      }
+      done = true;
+    });
+
+    while (!done) {
+      Color pixel = film.resolve().get_pixel(1, 0);
+      if (pixel.a > 0) {
+        REQUIRE(pixel.r == 1);
+        REQUIRE(pixel.g == 1);
+        REQUIRE(pixel.b == 1);
+      }
+    }
+
+    writer.join();
+    REQUIRE(film.samples(1, 0) == 100000);
+  }
+}
@@ -0,0 +1,119 @@
+#include <catch.hpp>
+#include <glm/glm.hpp>
+#include "mesh.hpp"
+#include "ray.hpp"
+#include "triangle.hpp"
+
+TEST_CASE("Triangle intersection is correct", "[intersection]") {
+  Mesh mesh;
+  mesh.V.push_back(glm::vec3(0, 0, 0));
+  mesh.V.push_back(glm::vec3(0, 2, 0));
+  mesh.V.push_back(glm::vec3(2, 0, 0));
+  mesh.N.push_back(glm::vec3(0, 0, -1));
+  mesh.M.push_back(Material());
+
+  Vertex a{0, 0, -1};
+  Vertex b{1, 0, -1};
+  Vertex c{2, 0, -1};
+
+  uint32_t triangle = mesh.add(a, b, c, 0);
+
+  SECTION("parallel ray does not intersect") {
+    Ray ray(glm::vec3(0, 0, 1), glm::vec3(1, 0, 0));
+    REQUIRE(!mesh.intersects(triangle, ray));
+  }
+
+  SECTION("out of bounds ray does not intersect") {
+    // Intersects plane at (-1, -1, 0) but not in triangle
+    Ray rayOne(glm::vec3(-2, -2, -1), glm::vec3(1, 1, 1));
+    auto interOne = mesh.intersects(triangle, rayOne);
+    REQUIRE(!interOne);
+
+    // Intersects plane at (2, 2, 0) but not in triangle
+    Ray rayTwo(glm::vec3(1, 1, -1), glm::vec3(1, 1, 1));
+    auto interTwo = mesh.intersects(triangle, rayTwo);
+    REQUIRE(!interTwo);
+  }
+
+  SECTION("in bounds ray intersects from bottom") {
+    // Intersects plane at (1, 1, 0) inside triangle
+    Ray ray(glm::vec3(0, 0, -1), glm::vec3(1, 1, 1));
+    auto inter = mesh.intersects(triangle, ray);
+    REQUIRE(inter);
+
+    glm::vec3 P = ray.at(inter.t);
+
+    REQUIRE(P.x == Approx(1));
+    REQUIRE(P.y == Approx(1));
+    REQUIRE(P.z == Approx(0));
+
+    REQUIRE(inter.N.x == Approx(0));
+    REQUIRE(inter.N.y == Approx(0));
+    REQUIRE(inter.N.z == Approx(-1));
+  }
+
+  SECTION("in bounds ray intersects from top") {
+    // Intersects plane at (1, 1, 0) inside triangle
+    Ray ray(glm::vec3(0, 0, 1), glm::vec3(1, 1, -1));
+    auto inter = mesh.intersects(triangle, ray);
+    REQUIRE(inter);
+
+    glm::vec3 P = ray.at(inter.t);
+
+    REQUIRE(P.x == Approx(1));
+    REQUIRE(P.y == Approx(1));
+    REQUIRE(P.z == Approx(0));
+
+    REQUIRE(inter.N.x == Approx(0));
+    REQUIRE(inter.N.y == Approx(0));
+    REQUIRE(inter.N.z == Approx(-1));
+  }
+
+  SECTION("occlusion respects the maximum distance") {
+    // Intersects plane at (1, 1, 0) inside triangle at distance sqrt(3)
+    Ray ray(glm::vec3(0, 0, -1), glm::vec3(1, 1, 1));
+    REQUIRE(mesh.occludes(triangle, ray, 2));
+    REQUIRE(!mesh.occludes(triangle, ray, 1.5));
+
+    // Intersects plane at (-1, -1, 0) but not in triangle
+    Ray miss(glm::vec3(-2, -2, -1), glm::vec3(1, 1, 1));
+    REQUIRE(!mesh.occludes(triangle, miss, 10));
+  }
+}
+
+TEST_CASE("Watertight intersection does not leak", "[intersection]") {
+  // Two triangles sharing the diagonal of the unit square.
+  glm::vec3 a(0, 0, 0);
+  glm::vec3 b(1, 0, 0);
+  glm::vec3 c(1, 1, 0);
+  glm::vec3 d(0, 1, 0);
+
+  Triangle lower = Triangle::vertices(a, b, c);
+  Triangle upper = Triangle::vertices(a, c, d);
+
+  Triangle::Hit hit;
+
+  // Rays through points on the shared edge hit at least one triangle.
+  for (int i = 1; i < 100; i++) {
+    glm::vec3 O(0.3f, 0.7f, 1);
+    glm::vec3 P(i / 100.0f, i / 100.0f, 0);
+    Ray ray(O, P - O);
+    Triangle::Shear shear(ray);
+
+    bool any = lower.intersect(ray, shear, 10, hit) ||
+               upper.intersect(ray, shear, 10, hit);
+    REQUIRE(any);
+    REQUIRE(hit.t == Approx(glm::distance(O, P)));
+  }
+
+  SECTION("barycentrics match the Moller-Trumbore kernel") {
+    Ray ray(glm::vec3(0.8f, 0.3f, 1), glm::vec3(0, 0, -1));
+    Triangle::Hit other{};
+
+    REQUIRE(lower.intersect(ray, Triangle::Shear(ray), 10, hit));
+    REQUIRE(Triangle::edges(a, b, c).intersect(ray, 10, other));
+    REQUIRE(hit.t == Approx(other.t));
+    REQUIRE(hit.u == Approx(other.u));
+    REQUIRE(hit.v == Approx(other.v));
+  }
+}
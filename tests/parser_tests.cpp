@@ -0,0 +1,112 @@
+#include <catch.hpp>
+#include <cstdio>
+#include <fstream>
+#include <glm/glm.hpp>
+#include <memory>
+#include <string>
+#include "config.hpp"
+#include "image.hpp"
+#include "parser.hpp"
+#include "ray.hpp"
+#include "scene.hpp"
+#include "test-scene.hpp"
+
+TEST_CASE("Scene cache round trips the parsed scene", "[parser]") {
+  const std::string directory = temp_directory("parser_tests");
+  const std::string scene_file = directory + "/parser_tests.obj";
+  const std::string mtl_file = directory + "/parser_tests.mtl";
+  const std::string cache_file = directory + "/parser_tests.obj.cache";
+
+  // A unit quad with an emissive triangle behind it.
+  auto write_scene = [&](float z) {
+    std::ofstream obj(scene_file);
+    obj << "mtllib parser_tests.mtl\n"
+        << "v 0 0 0\nv 1 0 0\nv 1 1 0\nv 0 1 0\n"
+        << "v 0 0 " << z << "\nv 1 0 " << z << "\nv 0 1 " << z << "\n"
+        << "usemtl white\nf 1 2 3\nf 1 3 4\n"
+        << "usemtl light\nf 5 6 7\n";
+
+    std::ofstream mtl(mtl_file);
+    mtl << "newmtl white\nKd 1 1 1\n"
+        << "newmtl light\nKe 1 1 1\n";
+  };
+
+  Config config;
+  config.job.threads = 1;
+  config.loader.textures = false;
+  config.loader.normals = true;
+  config.loader.cache = directory;
+  config.bvh.builder = "sah";
+  config.bvh.width = 4;
+  config.bvh.leaf_size = 1;
+  config.bvh.max_depth = 64;
+  config.bvh.bins = 16;
+  config.bvh.watertight = false;
+
+  auto parse = [&]() { return Parser(config).parse(scene_file, directory); };
+
+  auto depth = [](const Scene& scene, float x, float y) {
+    Ray ray(glm::vec3(x, y, 1), glm::vec3(0, 0, -1));
+    return scene.bvh.intersect(ray).t;
+  };
+
+  std::remove(cache_file.c_str());
+  write_scene(-1);
+
+  Scene parsed = parse();
+  REQUIRE(std::ifstream(cache_file).good());
+
+  SECTION("cached scene matches parsed scene") {
+    Scene cached = parse();
+    REQUIRE(cached.lights.size() == parsed.lights.size());
+    REQUIRE(cached.lights.size() == 1);
+
+    for (float x : {0.25f, 0.75f, 1.5f}) {
+      REQUIRE(depth(cached, x, 0.1f) == depth(parsed, x, 0.1f));
+    }
+  }
+
+  SECTION("stale cache is rebuilt") {
+    write_scene(-2);
+    Scene updated = parse();
+    REQUIRE(depth(updated, 0.1f, 0.1f) == Approx(1));
+
+    // Hide the quad to reach the moved triangle.
+    Ray ray(glm::vec3(0.1f, 0.1f, -0.5f), glm::vec3(0, 0, -1));
+    REQUIRE(updated.bvh.intersect(ray).t == Approx(1.5f));
+    REQUIRE(parse().bvh.intersect(ray).t == Approx(1.5f));
+  }
+
+  SECTION("replicated scene owns a copy of the mesh") {
+    Scene replica = parsed.replicate();
+    REQUIRE(&replica.bvh.get_mesh() != &parsed.bvh.get_mesh());
+    REQUIRE(replica.lights.size() == parsed.lights.size());
+
+    for (float x : {0.25f, 0.75f, 1.5f}) {
+      REQUIRE(depth(replica, x, 0.1f) == depth(parsed, x, 0.1f));
+    }
+  }
+
+  std::remove(cache_file.c_str());
+  std::remove(scene_file.c_str());
+  std::remove(mtl_file.c_str());
+  remove_directory(directory);
+}
+
+TEST_CASE("Replicated scene copies each shared texture once", "[parser]") {
+  Config config = test_config();
+  auto mesh = test_mesh(1);
+
+  // Both materials use the same file like textures of an atlas.
+  auto texture = std::make_shared<Image>(2, 2);
+  mesh->M[0].Kd_texture = texture;
+  mesh->M[1].Kd_texture = texture;
+
+  Scene scene = test_scene(mesh, config);
+  Scene replica = scene.replicate();
+
+  const Mesh& copy = replica.bvh.get_mesh();
+  REQUIRE(copy.M[0].Kd_texture);
+  REQUIRE(copy.M[0].Kd_texture != texture);
+  REQUIRE(copy.M[1].Kd_texture == copy.M[0].Kd_texture);
+}
@@ -0,0 +1,69 @@
+#include <catch.hpp>
+#include <cmath>
+#include <glm/glm.hpp>
+#include "color.hpp"
+#include "config.hpp"
+#include "independent-sampler.hpp"
+#include "pathtracer.hpp"
+#include "ray.hpp"
+#include "scene.hpp"
+#include "test-scene.hpp"
+
+TEST_CASE("Direct lighting converges to the same light with and without MIS",
+          "[pathtracer]") {
+  const int samples = 1 << 16;
+
+  // A floor seen from above lit by a triangle above and behind its center,
+  // within the glossy lobe around the mirror direction of the camera ray.
+  Config config = test_config();
+  config.rendering.bounces = 8;
+  config.bvh.width = 2;
+
+  auto mesh = test_mesh(4);
+  Scene scene = test_scene(mesh, config);
+
+  Ray ray(glm::vec3(0, 2, 1), glm::vec3(0, -2, -1));
+
+  // Returns the mean and variance of the intensity of the camera ray.
+  auto estimate = [&](bool mis) {
+    config.rendering.mis = mis;
+    PathTracer pathtracer(config);
+    IndependentSampler sampler(3);
+
+    double sum = 0;
+    double squared = 0;
+    for (int i = 0; i < samples; i++) {
+      sampler.start(0, i);
+      Color color = pathtracer.trace(scene, ray, sampler);
+      double intensity = (color.r + color.g + color.b) / 3.0;
+      sum += intensity;
+      squared += intensity * intensity;
+    }
+
+    double mean = sum / samples;
+    return glm::dvec2(mean, squared / samples - mean * mean);
+  };
+
+  SECTION("on a diffuse surface") {
+    mesh->M[0].Kd = Color(0.5f, 0.5f, 0.5f);
+
+    glm::dvec2 light = estimate(false);
+    glm::dvec2 combined = estimate(true);
+
+    REQUIRE(light.x > 0);
+    REQUIRE(std::abs(combined.x - light.x) < 0.03 * light.x);
+  }
+
+  SECTION("on a glossy surface") {
+    mesh->M[0].Kd = Color::BLACK;
+    mesh->M[0].Ks = Color(0.5f, 0.5f, 0.5f);
+    mesh->M[0].Pr = 0.5f;
+
+    glm::dvec2 reflected = estimate(false);
+    glm::dvec2 combined = estimate(true);
+
+    REQUIRE(reflected.x > 0);
+    REQUIRE(std::abs(combined.x - reflected.x) < 0.03 * reflected.x);
+    REQUIRE(combined.y < 0.5 * reflected.y);
+  }
+}
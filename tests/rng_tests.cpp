@@ -0,0 +1,49 @@
+#include <catch.hpp>
+#include <vector>
+#include "rng.hpp"
+
+TEST_CASE("RNG draws reproducible uniform numbers", "[rng]") {
+  SECTION("the same seed and stream repeat the sequence") {
+    RNG a(7, 3);
+    RNG b(7, 3);
+    for (int i = 0; i < 100; i++) {
+      REQUIRE(a() == b());
+    }
+  }
+
+  SECTION("streams of the same seed differ") {
+    RNG a(7, 0);
+    RNG b(7, 1);
+
+    int equal = 0;
+    for (int i = 0; i < 100; i++) {
+      equal += a() == b();
+    }
+    REQUIRE(equal < 5);
+  }
+
+  SECTION("floats are in [0, 1) with the expected mean") {
+    RNG rng(1);
+    double sum = 0;
+    for (int i = 0; i < 100000; i++) {
+      float u = rng.uniform();
+      REQUIRE(u >= 0);
+      REQUIRE(u < 1);
+      sum += u;
+    }
+    REQUIRE(sum / 100000 == Approx(0.5).epsilon(0.01));
+  }
+
+  SECTION("bounded integers cover the range evenly") {
+    RNG rng(1);
+    std::vector<int> counts(6, 0);
+    for (int i = 0; i < 60000; i++) {
+      uint32_t n = rng.bounded(6);
+      REQUIRE(n < 6);
+      counts[n]++;
+    }
+    for (int count : counts) {
+      REQUIRE(count == Approx(10000).epsilon(0.05));
+    }
+  }
+}
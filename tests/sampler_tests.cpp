@@ -0,0 +1,85 @@
+#include <catch.hpp>
+#include <cmath>
+#include <glm/glm.hpp>
+#include <string>
+#include <vector>
+#include "config.hpp"
+#include "sampler.hpp"
+
+TEST_CASE("Samplers draw reproducible points in the unit square",
+          "[sampler]") {
+  Config config;
+  config.rendering.seed = 5;
+
+  for (std::string name : {"independent", "halton", "sobol"}) {
+    config.rendering.sampler = name;
+    auto a = Sampler::create(config);
+    auto b = Sampler::create(config);
+
+    for (uint32_t sample = 0; sample < 64; sample++) {
+      a->start(7, sample);
+      b->start(7, sample);
+
+      // Run past the Halton dimensions.
+      for (int i = 0; i < 20; i++) {
+        glm::vec2 p = a->next_2d();
+        REQUIRE(p == b->next_2d());
+        REQUIRE(p.x >= 0);
+        REQUIRE(p.x < 1);
+        REQUIRE(p.y >= 0);
+        REQUIRE(p.y < 1);
+        REQUIRE(a->bounded(3) == b->bounded(3));
+      }
+    }
+  }
+}
+
+TEST_CASE("Low discrepancy samplers reduce integration error", "[sampler]") {
+  Config config;
+  config.rendering.seed = 5;
+
+  // Estimates the integral of a smooth function over the unit square at
+  // every pixel and returns the mean squared error.
+  auto error = [&](const std::string& name, uint32_t samples) {
+    config.rendering.sampler = name;
+    auto sampler = Sampler::create(config);
+
+    double squared = 0;
+    for (uint32_t pixel = 0; pixel < 256; pixel++) {
+      double sum = 0;
+      for (uint32_t sample = 0; sample < samples; sample++) {
+        sampler->start(pixel, sample);
+        sampler->next_2d();
+        glm::vec2 p = sampler->next_2d();
+        sum += std::sin(3 * p.x) * p.y * p.y;
+      }
+
+      double expected = (1 - std::cos(3.0)) / 3 / 3;
+      double estimate = sum / samples;
+      squared += (estimate - expected) * (estimate - expected);
+    }
+    return squared / 256;
+  };
+
+  double independent = error("independent", 64);
+  REQUIRE(error("halton", 64) < independent / 4);
+  REQUIRE(error("sobol", 64) < independent / 4);
+
+  SECTION("sobol points are stratified") {
+    config.rendering.sampler = "sobol";
+    auto sampler = Sampler::create(config);
+
+    // Every power of two prefix covers each of as many strata once.
+    std::vector<int> strata(16, 0);
+    for (uint32_t sample = 0; sample < 16; sample++) {
+      sampler->start(3, sample);
+      sampler->next_1d();
+      glm::vec2 p = sampler->next_2d();
+      strata[static_cast<int>(p.x * 4) * 4 + static_cast<int>(p.y * 4)]++;
+    }
+
+    for (int count : strata) {
+      REQUIRE(count == 1);
+    }
+  }
+}
@@ -0,0 +1,81 @@
+#include "test-scene.hpp"
+#include <cstdlib>
+#include <glm/glm.hpp>
+#include "area-light.hpp"
+#include "bvh.hpp"
+#include "color.hpp"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <unistd.h>
+#define TEST_SCENE_MKDTEMP
+#endif
+
+Config test_config() {
+  Config config;
+  config.job.threads = 1;
+  config.job.batch = 1;
+  config.job.time_limit = 0;
+  config.rendering.bounces = 2;
+  config.rendering.samples = 1;
+  config.rendering.epsilon = 0.001f;
+  config.rendering.background = Color::BLACK;
+  config.rendering.seed = 3;
+  config.rendering.sampler = "independent";
+  config.rendering.integrator = "path";
+  config.rendering.sort = false;
+  config.rendering.mis = true;
+  config.adaptive.threshold = 0;
+  config.adaptive.min_samples = 1;
+  config.adaptive.max_samples = 1;
+  config.bvh.builder = "sah";
+  config.bvh.width = 4;
+  config.bvh.leaf_size = 1;
+  config.bvh.max_depth = 64;
+  config.bvh.bins = 16;
+  config.bvh.watertight = false;
+  config.debug.normals = false;
+  config.debug.diffuse = false;
+  return config;
+}
+
+std::shared_ptr<Mesh> test_mesh(float floor) {
+  auto mesh = std::make_shared<Mesh>();
+  mesh->M.resize(2);
+  mesh->M[0].Kd = Color(0.8f, 0.8f, 0.8f);
+  mesh->M[1].Ke = Color(4, 4, 4);
+  mesh->V = {glm::vec3(-floor, 0, -floor), glm::vec3(floor, 0, -floor),
+             glm::vec3(floor, 0, floor),   glm::vec3(-floor, 0, floor),
+             glm::vec3(-1, 1, 0),          glm::vec3(1, 1, 0),
+             glm::vec3(0, 1, -1)};
+  mesh->add(Vertex{0, -1, -1}, Vertex{1, -1, -1}, Vertex{2, -1, -1}, 0);
+  mesh->add(Vertex{0, -1, -1}, Vertex{2, -1, -1}, Vertex{3, -1, -1}, 0);
+  mesh->add(Vertex{4, -1, -1}, Vertex{5, -1, -1}, Vertex{6, -1, -1}, 1);
+  return mesh;
+}
+
+Scene test_scene(std::shared_ptr<Mesh> mesh, const Config& config) {
+  Scene scene;
+  scene.bvh = BVH::build(mesh, config);
+  scene.lights.emplace_back(new AreaLight(mesh, 2));
+  return scene;
+}
+
+std::string temp_directory(const std::string& name) {
+#ifdef TEST_SCENE_MKDTEMP
+  const char* tmp = std::getenv("TMPDIR");
+  std::string pattern =
+      std::string(tmp && *tmp ? tmp : "/tmp") + "/" + name + ".XXXXXX";
+  if (mkdtemp(&pattern[0]) != nullptr) {
+    return pattern;
+  }
+#endif
+  return ".";
+}
+
+void remove_directory(const std::string& directory) {
+#ifdef TEST_SCENE_MKDTEMP
+  if (directory != ".") {
+    rmdir(directory.c_str());
+  }
+#endif
+}
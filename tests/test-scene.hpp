@@ -0,0 +1,39 @@
+#include <memory>
+#include <string>
+#include "config.hpp"
+#include "mesh.hpp"
+#include "scene.hpp"
+
+#ifndef TEST_SCENE_HPP_
+#define TEST_SCENE_HPP_
+
+/**
+ * Returns a config with every key read while rendering set for small single
+ * threaded test renders. Tests change only the keys they depend on.
+ */
+Config test_config();
+
+/**
+ * Returns a diffuse floor spanning [-floor, floor] on the x and z axes below
+ * an emissive triangle at a height of 1. The floor uses material 0 and the
+ * light, which is triangle 2, material 1.
+ */
+std::shared_ptr<Mesh> test_mesh(float floor);
+
+/**
+ * Builds the BVH of the test mesh and adds its light.
+ */
+Scene test_scene(std::shared_ptr<Mesh> mesh, const Config& config);
+
+/**
+ * Creates an empty directory named after the test for its files. Falls back
+ * to the working directory where temporary directories are not supported.
+ */
+std::string temp_directory(const std::string& name);
+
+/**
+ * Removes the directory created by temp_directory() once it is empty.
+ */
+void remove_directory(const std::string& directory);
+
+#endif  // TEST_SCENE_HPP_
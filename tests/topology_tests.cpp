@@ -0,0 +1,34 @@
+#include <catch.hpp>
+#include <vector>
+#include "topology.hpp"
+
+TEST_CASE("Topology places threads on CPUs", "[topology]") {
+  SECTION("CPU lists are parsed") {
+    REQUIRE(Topology::parse("0-3,8,10-11") ==
+            std::vector<int>({0, 1, 2, 3, 8, 10, 11}));
+    REQUIRE(Topology::parse("").empty());
+  }
+
+  Topology topology({{0, 1, 2}, {4, 5}});
+  REQUIRE(topology.cpus() == 5);
+  REQUIRE(topology.node(5) == 1);
+
+  SECTION("compact fills one node before the next") {
+    REQUIRE(topology.place(4, "compact") == std::vector<int>({0, 1, 2, 4}));
+  }
+
+  SECTION("scatter alternates between nodes") {
+    REQUIRE(topology.place(6, "scatter") ==
+            std::vector<int>({0, 4, 1, 5, 2, 0}));
+  }
+
+  SECTION("none leaves threads unpinned") {
+    REQUIRE(topology.place(2, "none") == std::vector<int>({-1, -1}));
+  }
+
+  SECTION("the detected topology has a CPU to pin to") {
+    Topology detected = Topology::detect();
+    REQUIRE(detected.cpus() > 0);
+    REQUIRE_FALSE(detected.nodes.front().empty());
+  }
+}
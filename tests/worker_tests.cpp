@@ -0,0 +1,385 @@
+#include <catch.hpp>
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <limits>
+#include <string>
+#include <thread>
+#include <vector>
+#include "color.hpp"
+#include "config.hpp"
+#include "film.hpp"
+#include "image.hpp"
+#include "scene.hpp"
+#include "test-scene.hpp"
+#include "worker.hpp"
+
+TEST_CASE("Work queue samples partitions in passes", "[queue]") {
+  const int partitions = 64;
+  const int samples = 20;
+
+  std::vector<Worker::Work> work;
+  for (int i = 0; i < partitions; i++) {
+    work.push_back(Worker::Work{glm::ivec2(i, 0), glm::ivec2(i + 1, 1), 0});
+  }
+
+  SECTION("single thread renders passes in order") {
+    Worker::Queue queue(work, 1);
+
+    int polls = 0;
+    Worker::Work* next;
+    while ((next = queue.poll(0)) != nullptr) {
+      // Every partition gets its sample before any gets the next one.
+      REQUIRE(next->samples == polls / partitions);
+      REQUIRE(queue.samples() == next->samples);
+      polls++;
+
+      if (++next->samples < samples) {
+        queue.push(0, next);
+      } else {
+        queue.finish();
+      }
+    }
+
+    REQUIRE(polls == partitions * samples);
+  }
+
+  SECTION("batches of samples are taken in passes") {
+    const int batch = 3;
+    Worker::Queue queue(work, 1, batch);
+
+    int polls = 0;
+    Worker::Work* next;
+    while ((next = queue.poll(0)) != nullptr) {
+      REQUIRE(next->samples == polls / partitions * batch);
+      REQUIRE(queue.samples() == next->samples);
+      polls++;
+
+      next->samples = std::min(next->samples + batch, samples);
+      if (next->samples < samples) {
+        queue.push(0, next);
+      } else {
+        queue.finish();
+      }
+    }
+
+    // The last batch takes the remaining 2 samples.
+    REQUIRE(polls == partitions * 7);
+  }
+
+  SECTION("threads render every sample exactly once") {
+    const int threads = 4;
+    Worker::Queue queue(work, threads);
+
+    std::vector<std::atomic<int>> counts(partitions);
+    for (auto& count : counts) {
+      count = 0;
+    }
+
+    auto run = [&](int thread) {
+      Worker::Work* next;
+      while ((next = queue.poll(thread)) != nullptr) {
+        counts[next->begin.x]++;
+
+        if (++next->samples < samples) {
+          queue.push(thread, next);
+        } else {
+          queue.finish();
+        }
+      }
+    };
+
+    std::vector<std::thread> pool;
+    for (int i = 0; i < threads; i++) {
+      pool.emplace_back(run, i);
+    }
+    for (auto& thread : pool) {
+      thread.join();
+    }
+
+    for (const auto& count : counts) {
+      REQUIRE(count == samples);
+    }
+  }
+
+  SECTION("stopping leaves partitions within one pass") {
+    const int threads = 4;
+    Worker::Queue queue(work, threads, 1,
+                        std::numeric_limits<int64_t>::max(),
+                        std::numeric_limits<int>::max(), true);
+    std::atomic<int> polls(0);
+
+    std::vector<std::atomic<int>> counts(partitions);
+    for (auto& count : counts) {
+      count = 0;
+    }
+
+    auto run = [&](int thread) {
+      Worker::Work* next;
+      while ((next = queue.poll(thread)) != nullptr) {
+        counts[next->begin.x]++;
+
+        // Stop in the middle of a pass like a deadline would.
+        if (++polls == partitions * samples / 2 + partitions / 3) {
+          queue.stop();
+        }
+
+        if (++next->samples < samples) {
+          queue.push(thread, next);
+        } else {
+          queue.finish();
+        }
+      }
+    };
+
+    std::vector<std::thread> pool;
+    for (int i = 0; i < threads; i++) {
+      pool.emplace_back(run, i);
+    }
+    for (auto& thread : pool) {
+      thread.join();
+    }
+
+    auto range = std::minmax_element(counts.begin(), counts.end());
+    REQUIRE(*range.first == queue.samples());
+    REQUIRE(*range.second <= *range.first + 1);
+    REQUIRE(*range.first < samples);
+  }
+}
+
+TEST_CASE("Tiles cover the image exactly once", "[queue]") {
+  const int width = 70;
+  const int height = 45;
+  const int size = 16;
+
+  for (std::string order : {"scanline", "morton", "hilbert"}) {
+    auto tiles = Worker::tiles(width, height, size, order);
+    REQUIRE(tiles.size() == 5 * 3);
+
+    std::vector<int> covered(width * height, 0);
+    for (const auto& tile : tiles) {
+      REQUIRE(tile.samples == 0);
+      for (int y = tile.begin.y; y < tile.end.y; y++) {
+        for (int x = tile.begin.x; x < tile.end.x; x++) {
+          covered[y * width + x]++;
+        }
+      }
+    }
+
+    for (int count : covered) {
+      REQUIRE(count == 1);
+    }
+  }
+
+  SECTION("scanline tiles go row by row") {
+    auto tiles = Worker::tiles(width, height, size, "scanline");
+    REQUIRE(tiles[4].begin == glm::ivec2(64, 0));
+    REQUIRE(tiles[4].end == glm::ivec2(70, 16));
+    REQUIRE(tiles[5].begin == glm::ivec2(0, 16));
+  }
+
+  SECTION("consecutive hilbert tiles are adjacent") {
+    auto tiles = Worker::tiles(4 * size, 4 * size, size, "hilbert");
+    REQUIRE(tiles.size() == 16);
+
+    for (size_t i = 1; i < tiles.size(); i++) {
+      glm::ivec2 step = glm::abs(tiles[i].begin - tiles[i - 1].begin);
+      REQUIRE(step.x + step.y == size);
+    }
+  }
+}
+
+TEST_CASE("Seeded renders are reproducible", "[worker]") {
+  const int size = 12;
+
+  // A lit floor below an emissive triangle.
+  Config config = test_config();
+  config.job.batch = 2;
+  config.rendering.samples = 5;
+  config.rendering.background = Color(0.1f, 0.1f, 0.1f);
+
+  Scene scene = test_scene(test_mesh(1), config);
+  scene.camera.set_position(glm::vec3(0, 0.5f, 2), glm::vec3(0, 0, 0),
+                            glm::vec3(0, 1, 0));
+  scene.camera.set_view(glm::radians(60.0f), size, size);
+
+  auto render = [&](int threads, const std::string& order) {
+    Film film(size, size);
+    Worker::Queue queue(Worker::tiles(size, size, 4, order), threads,
+                        config.job.batch);
+    std::atomic<int> running(threads);
+
+    std::vector<std::thread> pool;
+    for (int i = 0; i < threads; i++) {
+      pool.emplace_back(Worker(config, scene, film, queue, i, running));
+    }
+    for (auto& thread : pool) {
+      thread.join();
+    }
+
+    return film.resolve();
+  };
+
+  for (std::string sampler : {"independent", "halton", "sobol"}) {
+    config.rendering.sampler = sampler;
+    Image expected = render(1, "scanline");
+    Image actual = render(3, "hilbert");
+
+    for (size_t i = 0; i < expected.size(); i++) {
+      REQUIRE(actual.get_pixel(i).r == expected.get_pixel(i).r);
+      REQUIRE(actual.get_pixel(i).g == expected.get_pixel(i).g);
+      REQUIRE(actual.get_pixel(i).b == expected.get_pixel(i).b);
+    }
+  }
+
+  SECTION("the wavefront integrator renders the same image") {
+    Image expected = render(1, "scanline");
+    config.rendering.integrator = "wavefront";
+
+    for (bool sort : {false, true}) {
+      config.rendering.sort = sort;
+      Image actual = render(3, "hilbert");
+
+      for (size_t i = 0; i < expected.size(); i++) {
+        REQUIRE(actual.get_pixel(i).r == expected.get_pixel(i).r);
+        REQUIRE(actual.get_pixel(i).g == expected.get_pixel(i).g);
+        REQUIRE(actual.get_pixel(i).b == expected.get_pixel(i).b);
+      }
+    }
+  }
+
+  SECTION("another seed renders another image") {
+    Image expected = render(1, "scanline");
+    config.rendering.seed = 4;
+    Image other = render(1, "scanline");
+
+    int differ = 0;
+    for (size_t i = 0; i < expected.size(); i++) {
+      differ += other.get_pixel(i).r != expected.get_pixel(i).r;
+    }
+    REQUIRE(differ > 0);
+  }
+}
+
+TEST_CASE("A time limit stops every pixel within one sample", "[worker]") {
+  const int size = 12;
+  const int threads = 3;
+
+  // Batches of several samples would leave pixels a whole batch apart.
+  Config config = test_config();
+  config.job.batch = 4;
+  config.job.time_limit = 1;
+  config.rendering.samples = 1 << 12;
+
+  Scene scene = test_scene(test_mesh(1), config);
+  scene.camera.set_position(glm::vec3(0, 0.5f, 2), glm::vec3(0, 0, 0),
+                            glm::vec3(0, 1, 0));
+  scene.camera.set_view(glm::radians(60.0f), size, size);
+
+  Film film(size, size);
+  Worker::Queue queue(Worker::tiles(size, size, 4, "scanline"), threads,
+                      Worker::batch(config),
+                      std::numeric_limits<int64_t>::max(),
+                      config.rendering.samples, Worker::strict(config));
+  std::atomic<int> running(threads);
+
+  std::vector<std::thread> pool;
+  for (int i = 0; i < threads; i++) {
+    pool.emplace_back(Worker(config, scene, film, queue, i, running));
+  }
+
+  // Stop in the middle of the render like the deadline would.
+  while (queue.samples() < 6) {
+    std::this_thread::yield();
+  }
+  queue.stop();
+
+  for (auto& thread : pool) {
+    thread.join();
+  }
+
+  uint32_t least = film.samples(0, 0);
+  uint32_t most = least;
+  for (int y = 0; y < size; y++) {
+    for (int x = 0; x < size; x++) {
+      least = std::min(least, film.samples(x, y));
+      most = std::max(most, film.samples(x, y));
+    }
+  }
+
+  REQUIRE(least >= 6);
+  REQUIRE(most <= least + 1);
+  REQUIRE(most < static_cast<uint32_t>(config.rendering.samples));
+}
+
+TEST_CASE("Adaptive sampling moves samples to noisy tiles", "[worker]") {
+  const int size = 16;
+  const int samples = 16;
+
+  // A lit floor in the lower half of the image below an empty sky.
+  Config config = test_config();
+  config.job.batch = 4;
+  config.rendering.samples = samples;
+  config.rendering.background = Color(0.5f, 0.5f, 0.5f);
+  config.adaptive.threshold = 0.01f;
+  config.adaptive.min_samples = 4;
+  config.adaptive.max_samples = 4 * samples;
+
+  Scene scene = test_scene(test_mesh(4), config);
+  scene.camera.set_position(glm::vec3(0, 0.5f, 3), glm::vec3(0, 0.5f, 0),
+                            glm::vec3(0, 1, 0));
+  scene.camera.set_view(glm::radians(60.0f), size, size);
+
+  int64_t budget = static_cast<int64_t>(size * size) * samples;
+
+  auto render = [&](int threads, Film& film) {
+    Worker::Queue queue(Worker::tiles(size, size, 4, "scanline"), threads,
+                        config.job.batch, budget, config.adaptive.max_samples,
+                        Worker::strict(config));
+    std::atomic<int> running(threads);
+
+    std::vector<std::thread> pool;
+    for (int i = 0; i < threads; i++) {
+      pool.emplace_back(Worker(config, scene, film, queue, i, running));
+    }
+    for (auto& thread : pool) {
+      thread.join();
+    }
+  };
+
+  Film film(size, size);
+  render(1, film);
+
+  // The sky has no noise so it stops at the minimum.
+  REQUIRE(film.samples(0, 0) == config.adaptive.min_samples);
+
+  int64_t total = 0;
+  uint32_t most = 0;
+  for (int y = 0; y < size; y++) {
+    for (int x = 0; x < size; x++) {
+      total += film.samples(x, y);
+      most = std::max(most, film.samples(x, y));
+    }
+  }
+
+  // The floor takes the samples the sky left over.
+  REQUIRE(most > samples);
+  REQUIRE(total <= budget);
+
+  SECTION("the budget goes to the same tiles with any number of threads") {
+    Film other(size, size);
+    render(3, other);
+
+    Image expected = film.resolve();
+    Image actual = other.resolve();
+    for (int y = 0; y < size; y++) {
+      for (int x = 0; x < size; x++) {
+        REQUIRE(other.samples(x, y) == film.samples(x, y));
+      }
+    }
+    for (size_t i = 0; i < expected.size(); i++) {
+      REQUIRE(actual.get_pixel(i).r == expected.get_pixel(i).r);
+    }
+  }
+}